@@ -0,0 +1,185 @@
+#include "../doctest.h"
+#include <pre/memory>
+#include <thread>
+#include <vector>
+
+TEST_CASE("HeapArena") {
+    SUBCASE("Alignment") {
+        pre::HeapArena<> arena(4096);
+        for (size_t align : {1, 16, 32, 64, 256, 4096}) {
+            for (int k = 0; k < 20; k++) {
+                // Sizes that do not keep the offset aligned.
+                void* ptr = arena.allocate(8 + 16 * k, align);
+                CHECK(std::uintptr_t(ptr) % std::max<size_t>(align, 16) == 0);
+            }
+        }
+        // Alignment not a power of 2 should throw.
+        CHECK_THROWS_AS(arena.allocate(16, 48), std::invalid_argument);
+    }
+    SUBCASE("Over-aligned types") {
+        struct alignas(64) Line {
+            int value = 0;
+        };
+        pre::HeapArena<> arena;
+        (void)arena.allocate(16);
+        Line* line = new (arena) Line{42};
+        Line* lines = new (arena) Line[3];
+        CHECK(std::uintptr_t(line) % 64 == 0);
+        CHECK(std::uintptr_t(lines) % 64 == 0);
+        CHECK(line->value == 42);
+        // Allocator should propagate alignment.
+        std::vector<Line, pre::HeapArenaAllocator<Line>> vec(5);
+        CHECK(std::uintptr_t(vec.data()) % 64 == 0);
+    }
+}
+
+TEST_CASE("HeapArena markers") {
+    pre::HeapArena<> arena(1024);
+    void* ptr0 = arena.allocate(100);
+    auto marker = arena.mark();
+    void* ptr1 = arena.allocate(100);
+    {
+        // Fill several blocks in a nested scope.
+        auto scoped = arena.scoped_mark();
+        for (int k = 0; k < 100; k++)
+            (void)arena.allocate(200);
+    }
+    // Should continue right where the scope began.
+    CHECK(arena.allocate(100) == static_cast<std::byte*>(ptr1) + 112);
+    arena.rewind(marker);
+    CHECK(arena.allocate(100) == ptr1);
+    // Rewinding to a stale marker should throw.
+    auto inner = arena.mark();
+    arena.rewind(marker);
+    (void)arena.allocate(16);
+    CHECK_THROWS_AS(arena.rewind(inner), std::logic_error);
+    arena.clear();
+    CHECK(arena.allocate(100) == ptr0);
+    // Rewinding across a clear should throw, even if the position
+    // looks valid.
+    marker = arena.mark();
+    arena.clear();
+    (void)arena.allocate(64);
+    (void)arena.allocate(64);
+    CHECK_THROWS_AS(arena.rewind(marker), std::logic_error);
+    marker = arena.mark();
+    arena.reset();
+    (void)arena.allocate(256);
+    CHECK_THROWS_AS(arena.rewind(marker), std::logic_error);
+    // Clearing inside a scoped mark should not terminate, and the stale
+    // rewind should do nothing.
+    {
+        auto scoped = arena.scoped_mark();
+        arena.clear();
+        (void)arena.allocate(64);
+    }
+    CHECK(arena.allocate(16) == static_cast<std::byte*>(ptr0) + 64);
+}
+
+TEST_CASE("HeapArena stats") {
+    using Arena = pre::HeapArena<std::allocator<std::byte>, pre::MemoryStats>;
+    // Should cost nothing if not tracking.
+    CHECK(std::is_empty_v<pre::NoMemoryStats>);
+    CHECK(sizeof(pre::HeapArena<>) < sizeof(Arena));
+    Arena arena(1024);
+    CHECK(arena.stats().block_count == 1);
+    CHECK(arena.stats().block_bytes == 1024);
+    (void)arena.allocate(100);
+    CHECK(arena.stats().bytes == 112);
+    auto marker = arena.mark();
+    for (int k = 0; k < 10; k++)
+        (void)arena.allocate(500);
+    CHECK(arena.stats().bytes == 112 + 10 * 512);
+    CHECK(arena.stats().allocation_count == 11);
+    CHECK(arena.stats().block_count == 6);
+    // Should count wasted tail space as fragmentation.
+    CHECK(arena.stats().fragmentation() > 0.0);
+    arena.rewind(marker);
+    CHECK(arena.stats().bytes == 112);
+    CHECK(arena.stats().peak_bytes == 112 + 10 * 512);
+    arena.reset_peak();
+    CHECK(arena.stats().peak_bytes == 112);
+    arena.reset();
+    CHECK(arena.stats().bytes == 0);
+    CHECK(arena.stats().block_count == 1);
+    // Allocator should expose arena stats.
+    pre::HeapArenaAllocator<int, std::allocator<std::byte>, pre::MemoryStats>
+            alloc;
+    std::vector<int, decltype(alloc)> values(100, alloc);
+    CHECK(alloc.stats().bytes >= 400);
+}
+
+TEST_CASE("HeapStack stats") {
+    pre::HeapStack<std::allocator<std::byte>, pre::MemoryStats> stack(1024);
+    (void)stack.allocate(100);
+    stack.push();
+    for (int k = 0; k < 10; k++)
+        (void)stack.allocate(500);
+    CHECK(stack.stats().bytes == 112 + 10 * 512);
+    CHECK(stack.stats().block_count == 6);
+    stack.pop();
+    CHECK(stack.stats().bytes == 112);
+    CHECK(stack.stats().peak_bytes == 112 + 10 * 512);
+    stack.clear();
+    CHECK(stack.stats().bytes == 0);
+    CHECK(stack.stats().block_count == 1);
+}
+
+TEST_CASE("HeapStack") {
+    SUBCASE("Alignment") {
+        pre::HeapStack<> stack(1024);
+        for (size_t align : {1, 16, 32, 64, 256, 2048}) {
+            stack.push();
+            for (int k = 0; k < 20; k++) {
+                void* ptr = stack.allocate(8 + 16 * k, align);
+                CHECK(std::uintptr_t(ptr) % std::max<size_t>(align, 16) == 0);
+            }
+            stack.pop();
+        }
+        CHECK_THROWS_AS(stack.allocate(16, 3), std::invalid_argument);
+    }
+}
+
+TEST_CASE("ConcurrentHeapArena") {
+    pre::ConcurrentHeapArena<> arena(4096);
+    for (int round = 0; round < 3; round++) {
+        std::vector<std::thread> threads;
+        std::vector<std::vector<std::pair<int*, int>>> allocs(4);
+        for (int index = 0; index < 4; index++) {
+            threads.emplace_back([&, index] {
+                for (int k = 0; k < 2000; k++) {
+                    // Mostly small, sometimes larger than a block.
+                    int count = k % 100 == 0 ? 2000 : 1 + k % 13;
+                    int* values = arena.allocate<int>(count);
+                    for (int j = 0; j < count; j++)
+                        values[j] = index;
+                    allocs[index].emplace_back(values, count);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        // Allocations should never overlap, so every value should be
+        // intact, and every allocation should be 16-byte aligned.
+        bool intact = true;
+        bool aligned = true;
+        for (int index = 0; index < 4; index++) {
+            for (auto [values, count] : allocs[index]) {
+                aligned = aligned && std::uintptr_t(values) % 16 == 0;
+                for (int j = 0; j < count; j++)
+                    intact = intact && values[j] == index;
+            }
+        }
+        CHECK(intact);
+        CHECK(aligned);
+        if (round == 0)
+            arena.clear();
+        else
+            arena.reset();
+    }
+    // Alignment should be respected.
+    for (int k = 0; k < 100; k++)
+        CHECK(std::uintptr_t(arena.allocate(8 + k, 64)) % 64 == 0);
+    // Zero size should be null.
+    CHECK(arena.allocate(0) == nullptr);
+}
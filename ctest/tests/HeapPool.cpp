@@ -0,0 +1,242 @@
+#include "../doctest.h"
+#include <algorithm>
+#include <pre/Timer>
+#include <pre/memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+TEST_CASE("HeapPool") {
+    SUBCASE("Allocate and deallocate") {
+        pre::HeapPool<> pool(24, 100);
+        // Pool size should be rounded up to fill the slab.
+        CHECK(pool.pool_size() >= 100);
+
+        std::vector<void*> ptrs;
+        for (size_t k = 0; k < 10 * pool.pool_size(); k++)
+            ptrs.push_back(pool.allocate());
+        // Pointers should be distinct.
+        std::vector<void*> sorted = ptrs;
+        std::sort(sorted.begin(), sorted.end());
+        CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+        // Pointers should be at least 8-byte aligned.
+        for (void* ptr : ptrs)
+            CHECK(std::uintptr_t(ptr) % 8 == 0);
+
+        // Deallocate every other pointer, in shuffled order.
+        std::mt19937 gen(1234);
+        std::shuffle(ptrs.begin(), ptrs.end(), gen);
+        for (size_t k = 0; k < ptrs.size(); k += 2)
+            CHECK_NOTHROW(pool.deallocate(ptrs[k]));
+        // Allocate again, should reuse freed pointers.
+        for (size_t k = 0; k < ptrs.size(); k += 2) {
+            void* ptr = pool.allocate();
+            CHECK(std::binary_search(sorted.begin(), sorted.end(), ptr));
+        }
+        // Deallocating a pointer off an element boundary should throw.
+        CHECK_THROWS_AS(
+                pool.deallocate(static_cast<std::byte*>(ptrs[1]) + 1),
+                std::logic_error);
+        // Deallocating null should do nothing.
+        CHECK_NOTHROW(pool.deallocate(nullptr));
+    }
+    SUBCASE("Clear and reset") {
+        pre::HeapPool<> pool(16);
+        void* ptr0 = pool.allocate();
+        for (int k = 0; k < 10000; k++)
+            (void)pool.allocate();
+        pool.clear();
+        // Should reuse pools after clear.
+        std::vector<void*> ptrs;
+        for (int k = 0; k < 10001; k++)
+            ptrs.push_back(pool.allocate());
+        CHECK(std::find(ptrs.begin(), ptrs.end(), ptr0) != ptrs.end());
+        pool.reset();
+        // Should be able to allocate after reset.
+        CHECK(pool.allocate() != nullptr);
+    }
+    SUBCASE("Large elements") {
+        pre::HeapPool<> pool(100000, 2);
+        void* ptr0 = pool.allocate();
+        void* ptr1 = pool.allocate();
+        void* ptr2 = pool.allocate();
+        std::memset(ptr2, 0, 100000);
+        CHECK_NOTHROW(pool.deallocate(ptr1));
+        CHECK_NOTHROW(pool.deallocate(ptr0));
+        CHECK_NOTHROW(pool.deallocate(ptr2));
+        // Pools larger than the maximum slab size should throw.
+        CHECK_THROWS_AS(pre::HeapPool<>(size_t(1) << 24), std::length_error);
+    }
+    SUBCASE("Move") {
+        pre::ObjectHeapPool<int> pool(0);
+        int* value = pool.create(42);
+        pre::ObjectHeapPool<int> other(std::move(pool));
+        CHECK(*value == 42);
+        CHECK_NOTHROW(other.destroy(value));
+    }
+}
+
+TEST_CASE("HeapPool stats") {
+    pre::ObjectHeapPool<double, std::allocator<std::byte>, pre::MemoryStats>
+            pool(0);
+    std::vector<double*> values;
+    for (int k = 0; k < 10000; k++)
+        values.push_back(pool.create(k));
+    CHECK(pool.stats().bytes == 10000 * sizeof(double));
+    CHECK(pool.stats().allocation_count == 10000);
+    CHECK(pool.stats().block_count == pool.pool_count());
+    for (int k = 0; k < 5000; k++)
+        pool.destroy(values[k]);
+    CHECK(pool.stats().bytes == 5000 * sizeof(double));
+    CHECK(pool.stats().peak_bytes == 10000 * sizeof(double));
+    // Freed elements should count as fragmentation.
+    CHECK(pool.stats().fragmentation() > 0.5);
+    pool.reset();
+    CHECK(pool.stats().bytes == 0);
+    CHECK(pool.stats().block_bytes == 0);
+}
+
+TEST_CASE("SizeClassHeapPool") {
+    using Pool = pre::SizeClassHeapPool<>;
+    SUBCASE("Size classes") {
+        bool rounds_up = true;
+        bool is_tight = true;
+        for (size_t size = 1; size <= Pool::MaxSize; size++) {
+            size_t index = Pool::class_of(size);
+            rounds_up = rounds_up && Pool::class_size(index) >= size;
+            is_tight = is_tight && //
+                       (index == 0 || Pool::class_size(index - 1) < size);
+        }
+        // Class should be the smallest that fits.
+        CHECK(rounds_up);
+        CHECK(is_tight);
+        CHECK(Pool::class_size(Pool::ClassCount - 1) == Pool::MaxSize);
+    }
+    SUBCASE("Allocate and deallocate") {
+        Pool pool;
+        std::vector<std::pair<void*, size_t>> allocs;
+        std::mt19937 gen(1234);
+        for (int k = 0; k < 10000; k++) {
+            size_t size = 1 + gen() % 1100;
+            void* ptr = pool.allocate(size);
+            std::memset(ptr, 0, size);
+            allocs.emplace_back(ptr, size);
+        }
+        auto stats = pool.stats();
+        size_t count = stats.large_count;
+        for (auto& cls : stats.classes) {
+            count += cls.count;
+            CHECK(cls.occupancy() <= 1.0);
+        }
+        // Counts should add up.
+        CHECK(count == 10000);
+        CHECK(stats.large_count > 0);
+        // Alignment should be respected.
+        void* ptr = pool.allocate(24, 16);
+        CHECK(std::uintptr_t(ptr) % 16 == 0);
+        pool.deallocate(ptr, 24, 16);
+        for (auto [ptr, size] : allocs)
+            pool.deallocate(ptr, size);
+        stats = pool.stats();
+        // Everything should be free, but pools should remain.
+        CHECK(stats.large_count == 0);
+        CHECK(stats.large_bytes == 0);
+        for (auto& cls : stats.classes) {
+            CHECK(cls.count == 0);
+            CHECK(cls.capacity > 0);
+        }
+        pool.reset();
+        CHECK(pool.stats().classes[0].pool_count == 0);
+    }
+}
+
+TEST_CASE("ConcurrentHeapPool") {
+    SUBCASE("Many threads") {
+        pre::ConcurrentObjectHeapPool<std::pair<int, int>> pool;
+        std::vector<std::thread> threads;
+        std::atomic_int failures = 0;
+        for (int index = 0; index < 4; index++) {
+            threads.emplace_back([&, index] {
+                std::vector<std::pair<int, int>*> objects;
+                for (int round = 0; round < 20; round++) {
+                    for (int k = 0; k < 500; k++)
+                        objects.push_back(pool.create(index, k));
+                    for (int k = 0; k < 500; k++)
+                        if (*objects[k] != std::pair(index, k))
+                            failures++;
+                    for (auto* object : objects)
+                        pool.destroy(object);
+                    objects.clear();
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        // Objects should never be shared between threads.
+        CHECK(failures == 0);
+    }
+    SUBCASE("Cross-thread deallocate") {
+        pre::ConcurrentObjectHeapPool<int> pool;
+        std::vector<int*> objects;
+        for (int k = 0; k < 1000; k++)
+            objects.push_back(pool.create(k));
+        // Deallocate on another thread, which then exits and flushes
+        // its magazine back to the depot.
+        std::thread([&] {
+            for (int* object : objects)
+                pool.destroy(object);
+        }).join();
+        // Allocate again, should reuse the same elements, except for
+        // those left over in the magazine of this thread.
+        std::vector<int*> sorted = objects;
+        std::sort(sorted.begin(), sorted.end());
+        int reused = 0;
+        for (int k = 0; k < 1000; k++)
+            reused += std::binary_search(
+                    sorted.begin(), sorted.end(), pool.create(k));
+        CHECK(reused >= 1000 - int(pool.BatchCount));
+    }
+    SUBCASE("Destroy before thread exit") {
+        auto pool = std::make_unique<pre::ConcurrentHeapPool<>>(16);
+        std::atomic_int state = 0;
+        std::thread thread([&] {
+            pool->deallocate(pool->allocate());
+            state = 1;
+            while (state != 2)
+                std::this_thread::yield();
+            // Should drop the magazine of the destroyed pool.
+            pre::ConcurrentHeapPool<> other(16);
+            other.deallocate(other.allocate());
+        });
+        while (state != 1)
+            std::this_thread::yield();
+        pool.reset();
+        state = 2;
+        thread.join();
+        CHECK(true);
+    }
+}
+
+TEST_CASE("HeapPool benchmark" * doctest::skip()) {
+    // Allocate and deallocate at random with many pools live at once,
+    // to check that the time per operation does not depend on the
+    // number of pools.
+    for (size_t pool_count : {1, 16, 256, 4096}) {
+        pre::HeapPool<> pool(32, 64);
+        std::vector<void*> ptrs;
+        for (size_t k = 0; k < pool_count * pool.pool_size(); k++)
+            ptrs.push_back(pool.allocate());
+        std::mt19937 gen(1234);
+        std::shuffle(ptrs.begin(), ptrs.end(), gen);
+        size_t iters = 1000000;
+        pre::SteadyTimer timer;
+        for (size_t k = 0; k < iters; k++) {
+            void*& ptr = ptrs[gen() % ptrs.size()];
+            pool.deallocate(ptr);
+            ptr = pool.allocate();
+        }
+        MESSAGE(pool_count << " pools: "
+                           << timer.nanoseconds() / double(iters)
+                           << " ns per iteration");
+    }
+}
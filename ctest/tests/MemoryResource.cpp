@@ -0,0 +1,58 @@
+#include "../doctest.h"
+#include <list>
+#include <memory_resource>
+#include <pre/memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+TEST_CASE("MemoryResource") {
+    SUBCASE("HeapArenaResource") {
+        pre::HeapArena<> arena;
+        pre::HeapArenaResource<> resource(arena);
+        std::pmr::vector<int> values(&resource);
+        for (int k = 0; k < 1000; k++)
+            values.push_back(k);
+        CHECK(values[999] == 999);
+        // Alignment should be respected.
+        void* ptr = resource.allocate(10, 64);
+        CHECK(std::uintptr_t(ptr) % 64 == 0);
+        // Should only be equal to itself.
+        pre::HeapArenaResource<> other(arena);
+        CHECK(resource.is_equal(resource));
+        CHECK(!resource.is_equal(other));
+    }
+    SUBCASE("HeapStackResource") {
+        pre::HeapStack<> stack;
+        pre::HeapStackResource<> resource(stack);
+        {
+            auto scoped = stack.scoped_push();
+            std::pmr::unordered_map<int, std::pmr::string> map(&resource);
+            for (int k = 0; k < 100; k++)
+                map[k] = std::pmr::string(50, 'a' + k % 26);
+            CHECK(std::string_view(map[27]) == std::string(50, 'b'));
+            // Allocator should propagate to strings.
+            CHECK(map[27].get_allocator().resource() == &resource);
+        }
+    }
+    SUBCASE("HeapPoolResource") {
+        pre::HeapPoolResource<> resource;
+        std::pmr::list<int> values(&resource);
+        for (int k = 0; k < 1000; k++)
+            values.push_back(k);
+        CHECK(values.back() == 999);
+        // Allocations should be aligned at least to their size, up to 16.
+        for (size_t bytes : {1, 8, 12, 24, 100, 1000, 5000}) {
+            for (size_t align : {1, 8, 16, 64}) {
+                void* ptr = resource.allocate(bytes, align);
+                CHECK(std::uintptr_t(ptr) % align == 0);
+                std::memset(ptr, 0, bytes);
+                resource.deallocate(ptr, bytes, align);
+            }
+        }
+        // Freed elements should be reused.
+        void* ptr0 = resource.allocate(24);
+        resource.deallocate(ptr0, 24);
+        CHECK(resource.allocate(20) == ptr0);
+    }
+}
@@ -0,0 +1,87 @@
+#include "../doctest.h"
+#include <pre/memory>
+
+#if __linux__
+
+TEST_CASE("PageAllocator") {
+    using HugePages = pre::PageReserve::HugePages;
+    for (HugePages huge_pages :
+         {HugePages::None, HugePages::Transparent, HugePages::Explicit}) {
+        auto reserve = std::make_shared<pre::PageReserve>(
+                size_t(1) << 30, huge_pages);
+        pre::PageAllocator<std::byte> alloc(reserve);
+        {
+            // Arena.
+            pre::HeapArena<pre::PageAllocator<std::byte>> arena(
+                    size_t(1) << 21, alloc);
+            for (int k = 0; k < 100; k++) {
+                auto* values = arena.allocate<int>(16384);
+                values[0] = values[16383] = k;
+            }
+            // Blocks should come from the reserve.
+            CHECK(reserve->allocated() >= 64 * 100 * 1024);
+            arena.reset();
+            // Only the current block should be left.
+            CHECK(reserve->allocated() <= (size_t(1) << 21));
+            // Memory should be usable again.
+            auto* values = arena.allocate<int>(16384);
+            values[0] = values[16383] = 1;
+        }
+        {
+            // Stack.
+            pre::HeapStack<pre::PageAllocator<std::byte>> stack(
+                    size_t(1) << 21, alloc);
+            for (int k = 0; k < 10; k++) {
+                auto* values = static_cast<int*>(stack.allocate(1 << 20));
+                values[0] = k;
+            }
+            stack.clear();
+            CHECK(reserve->allocated() <= (size_t(1) << 22));
+        }
+        {
+            // Pool.
+            pre::HeapPool<pre::PageAllocator<std::byte>> pool(64, 0, alloc);
+            std::vector<void*> ptrs;
+            for (int k = 0; k < 10000; k++)
+                ptrs.push_back(pool.allocate());
+            for (void* ptr : ptrs)
+                pool.deallocate(ptr);
+            CHECK(reserve->allocated() > 0);
+            pool.reset();
+            CHECK(reserve->allocated() == 0);
+        }
+    }
+    SUBCASE("Exhaustion") {
+        auto reserve = std::make_shared<pre::PageReserve>(size_t(1) << 21);
+        void* ptr0 = reserve->allocate(size_t(1) << 20, 1);
+        void* ptr1 = reserve->allocate(size_t(1) << 20, 1);
+        // Should be full.
+        CHECK_THROWS_AS(reserve->allocate(1, 1), std::bad_alloc);
+        // Freed ranges should merge.
+        reserve->deallocate(ptr1, size_t(1) << 20);
+        reserve->deallocate(ptr0, size_t(1) << 20);
+        CHECK(reserve->allocate(size_t(1) << 21, 1) == ptr0);
+    }
+    SUBCASE("Explicit fallback") {
+        pre::PageReserve reserve(size_t(1) << 30, HugePages::Explicit);
+        size_t page_size = reserve.page_size();
+        size_t huge_page_size = pre::PageReserve::HugePageSize;
+        void* ptr0 = reserve.allocate(page_size, 1);
+        // Should round to huge pages at first.
+        CHECK(reserve.allocated() == huge_page_size);
+        if (reserve.huge_pages() == HugePages::Transparent) {
+            // Should round to pages after falling back.
+            void* ptr1 = reserve.allocate(page_size, 1);
+            CHECK(reserve.allocated() == huge_page_size + page_size);
+            reserve.deallocate(ptr0, page_size);
+            reserve.deallocate(ptr1, page_size);
+        }
+        else {
+            reserve.deallocate(ptr0, page_size);
+        }
+        // Should release everything.
+        CHECK(reserve.allocated() == 0);
+    }
+}
+
+#endif // #if __linux__
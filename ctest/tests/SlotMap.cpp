@@ -0,0 +1,88 @@
+#include "../doctest.h"
+#include <algorithm>
+#include <pre/memory>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE("SlotMap") {
+    SUBCASE("Insert, get, and erase") {
+        pre::SlotMap<std::string> map;
+        auto handle0 = map.insert("zero");
+        auto handle1 = map.insert("one");
+        auto handle2 = map.emplace(3, 'x');
+        CHECK(map.size() == 3);
+        CHECK(map.at(handle1) == "one");
+        CHECK(*map.get(handle2) == "xxx");
+        // Erase should move the last value into place.
+        CHECK(map.erase(handle0));
+        CHECK(map.values()[0] == "xxx");
+        CHECK(map.handle_at(0) == handle2);
+        // Erased handle should be stale.
+        CHECK(!map.contains(handle0));
+        CHECK(map.get(handle0) == nullptr);
+        CHECK_THROWS_AS(map.at(handle0), std::out_of_range);
+        CHECK(!map.erase(handle0));
+        // Slot should be reused, but the old handle should stay stale.
+        auto handle3 = map.insert("three");
+        CHECK(handle3.index() == handle0.index());
+        CHECK(handle3.generation() != handle0.generation());
+        CHECK(!map.contains(handle0));
+        CHECK(map.at(handle3) == "three");
+        // Null handle should never be valid.
+        CHECK(!map.contains({}));
+        map.clear();
+        CHECK(map.empty());
+        CHECK(!map.contains(handle1));
+        CHECK(!map.contains(handle3));
+    }
+    SUBCASE("Random") {
+        pre::SlotMap<int, std::uint32_t> map;
+        std::vector<std::pair<pre::SlotMap<int, std::uint32_t>::Handle, int>>
+                live;
+        std::vector<pre::SlotMap<int, std::uint32_t>::Handle> dead;
+        std::mt19937 gen(1234);
+        for (int k = 0; k < 20000; k++) {
+            if (live.empty() || gen() % 3 != 0) {
+                live.emplace_back(map.insert(k), k);
+            }
+            else {
+                size_t pos = gen() % live.size();
+                CHECK(map.erase(live[pos].first));
+                dead.push_back(live[pos].first);
+                live[pos] = live.back();
+                live.pop_back();
+            }
+        }
+        CHECK(map.size() == live.size());
+        bool all_live = true;
+        for (auto [handle, value] : live)
+            all_live = all_live && map.get(handle) && *map.get(handle) == value;
+        bool all_dead = true;
+        for (auto handle : dead)
+            all_dead = all_dead && !map.contains(handle);
+        CHECK(all_live);
+        CHECK(all_dead);
+        // Dense values should match handles.
+        bool consistent = true;
+        for (size_t pos = 0; pos < map.size(); pos++)
+            consistent = consistent &&
+                         map.get(map.handle_at(pos)) == &map.values()[pos];
+        CHECK(consistent);
+    }
+    SUBCASE("Generation exhaustion") {
+        pre::SlotMap<int, std::uint32_t> map;
+        auto first = map.insert(0);
+        map.erase(first);
+        // Recycle the same slot until its generation runs out.
+        for (int k = 1; k < 254; k++)
+            map.erase(map.insert(k));
+        auto handle = map.insert(254);
+        CHECK(handle.generation() == map.MaxGeneration);
+        CHECK(handle.index() == first.index());
+        map.erase(handle);
+        // Slot should now be retired.
+        CHECK(map.insert(255).index() != first.index());
+        CHECK(!map.contains(first));
+    }
+}
@@ -0,0 +1,83 @@
+#include "../doctest.h"
+#include <pre/memory>
+#include <thread>
+
+TEST_CASE("StaticMpmcQueue") {
+    SUBCASE("Single thread") {
+        pre::StaticMpmcQueue<int, 8> queue;
+
+        for (int k = 0; k < 8; k++) {
+            // Should not throw yet.
+            CHECK_NOTHROW(queue.push(k));
+            // Size should track pushes.
+            CHECK(queue.size() == size_t(k + 1));
+        }
+
+        // If full, try push should fail.
+        CHECK(!queue.try_push(8));
+        // If full, push should throw.
+        CHECK_THROWS(queue.push(8));
+
+        for (int k = 0; k < 8; k++) {
+            // Pop should be least recently pushed.
+            CHECK(queue.pop() == k);
+        }
+
+        // Should now be empty.
+        CHECK(queue.empty());
+        // If empty, try pop should fail.
+        CHECK(!queue.try_pop());
+        // If empty, pop should throw.
+        CHECK_THROWS(queue.pop());
+
+        // Wrap around a few laps.
+        for (int k = 0; k < 100; k++) {
+            CHECK(queue.try_push(k));
+            CHECK(queue.try_push(k + 1));
+            int value = -1;
+            CHECK(queue.try_pop(value));
+            CHECK(value == k);
+            CHECK(queue.try_pop(value));
+            CHECK(value == k + 1);
+        }
+    }
+    SUBCASE("Non-trivial values") {
+        pre::StaticMpmcQueue<std::string, 4> queue;
+        CHECK(queue.try_emplace(3, 'a'));
+        CHECK(queue.try_push(std::string(100, 'b')));
+        CHECK(queue.pop() == "aaa");
+        // Leave one in the queue for the destructor.
+    }
+    SUBCASE("Many threads") {
+        pre::StaticMpmcQueue<int, 64> queue;
+        constexpr int Producers = 4;
+        constexpr int Consumers = 4;
+        constexpr int Count = 20000;
+        std::atomic<long> sum = 0;
+        std::atomic_int popped = 0;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < Producers; p++)
+            threads.emplace_back([&] {
+                for (int k = 1; k <= Count; k++)
+                    while (!queue.try_push(k))
+                        std::this_thread::yield();
+            });
+        for (int c = 0; c < Consumers; c++)
+            threads.emplace_back([&] {
+                while (popped < Producers * Count) {
+                    if (auto value = queue.try_pop()) {
+                        sum += *value;
+                        popped++;
+                    }
+                    else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        for (auto& thread : threads)
+            thread.join();
+        // Every value should come out exactly once.
+        CHECK(sum == long(Producers) * Count * (Count + 1) / 2);
+        CHECK(queue.empty());
+    }
+}
@@ -1,5 +1,8 @@
 #include "../doctest.h"
+#include <pre/Serializer>
 #include <pre/memory>
+#include <sstream>
+#include <vector>
 
 TEST_CASE("StaticQueue") {
     pre::StaticQueue<int, 8> queue;
@@ -47,3 +50,124 @@ TEST_CASE("StaticQueue") {
     // If empty, pop should throw.
     CHECK_THROWS(queue.pop());
 }
+
+TEST_CASE("StaticQueue wraparound") {
+    SUBCASE("Power of 2") {
+        pre::StaticQueue<int, 4> queue;
+        int next_push = 0;
+        int next_pop = 0;
+        for (int k = 0; k < 50; k++) {
+            // Keep between 1 and 4 values in the queue.
+            while (!queue.full())
+                queue.push(next_push++);
+            CHECK(queue.size() == 4);
+            // Iteration should follow queue order across the wrap.
+            int expect = next_pop;
+            for (int value : queue)
+                CHECK(value == expect++);
+            // Indexing should follow queue order across the wrap.
+            CHECK(queue[0] == next_pop);
+            CHECK(queue[-1] == next_push - 1);
+            CHECK(queue.back() == next_push - 1);
+            for (int j = 0; j < 1 + k % 3; j++)
+                CHECK(queue.pop() == next_pop++);
+        }
+    }
+    SUBCASE("Not power of 2") {
+        pre::StaticQueue<int, 5> queue;
+        for (int k = 0; k < 3; k++)
+            queue.push(k);
+        queue.pop();
+        queue.pop();
+        for (int k = 3; k < 7; k++)
+            queue.push(k);
+        // Values 2, 3, 4 at the end of the buffer, then 5, 6 at the start.
+        auto [span0, span1] = queue.spans();
+        CHECK(span0.size() == 3);
+        CHECK(span1.size() == 2);
+        CHECK(span0[0] == 2);
+        CHECK(span1[1] == 6);
+        CHECK(std::vector<int>(queue.begin(), queue.end()) ==
+              std::vector<int>{2, 3, 4, 5, 6});
+        CHECK(std::vector<int>(queue.rbegin(), queue.rend()) ==
+              std::vector<int>{6, 5, 4, 3, 2});
+        CHECK(std::vector<int>(queue.crbegin(), queue.crend()) ==
+              std::vector<int>{6, 5, 4, 3, 2});
+        // Bounds-checked access should wrap and count negatives from the
+        // back.
+        CHECK(queue.at(0) == 2);
+        CHECK(queue.at(3) == 5);
+        CHECK(queue.at(-1) == 6);
+        CHECK(std::as_const(queue).at(size_t(4)) == 6);
+        CHECK_THROWS_AS(queue.at(5), std::out_of_range);
+        CHECK_THROWS_AS(queue.at(-6), std::out_of_range);
+        // Consume first span in place.
+        queue.consume(span0.size());
+        CHECK(queue.size() == 2);
+        CHECK(queue.front() == 5);
+        // Consuming more than the size should throw.
+        CHECK_THROWS(queue.consume(3));
+        queue.consume(2);
+        CHECK(queue.empty());
+    }
+}
+
+TEST_CASE("StaticQueue pop to empty") {
+    pre::StaticQueue<int, 4> queue;
+    for (int k = 0; k < 3; k++)
+        queue.push(k);
+    for (int k = 0; k < 3; k++)
+        queue.pop();
+    for (int k = 0; k < 4; k++)
+        queue.push(k);
+    // Popping to empty should restart at the beginning of the buffer,
+    // so the next batch is contiguous.
+    auto [span0, span1] = queue.spans();
+    CHECK(span0.size() == 4);
+    CHECK(span1.empty());
+}
+
+TEST_CASE("StaticQueue serialization") {
+    pre::StaticQueue<int, 5> queue;
+    for (int k = 0; k < 4; k++)
+        queue.push(k);
+    queue.pop();
+    queue.pop();
+    for (int k = 4; k < 7; k++)
+        queue.push(k);
+    SUBCASE("Round trip with wraparound") {
+        std::stringstream ss;
+        {
+            pre::StandardSerializer serializer(static_cast<std::ostream&>(ss));
+            serializer <=> queue;
+        }
+        pre::StaticQueue<int, 5> other;
+        {
+            pre::StandardSerializer serializer(static_cast<std::istream&>(ss));
+            serializer <=> other;
+        }
+        CHECK(std::vector<int>(other.begin(), other.end()) ==
+              std::vector<int>{2, 3, 4, 5, 6});
+    }
+    SUBCASE("Read linear format") {
+        // Before the queue was circular, archives held the values, then
+        // the bottom and top indexes.
+        std::stringstream ss;
+        {
+            int values[5] = {0, 7, 8, 9, 0};
+            size_t bot = 1;
+            size_t top = 4;
+            pre::StandardSerializer serializer(static_cast<std::ostream&>(ss));
+            serializer <=> values;
+            serializer <=> bot;
+            serializer <=> top;
+        }
+        {
+            pre::StandardSerializer serializer(static_cast<std::istream&>(ss));
+            serializer <=> queue;
+        }
+        CHECK(queue.size() == 3);
+        CHECK(std::vector<int>(queue.begin(), queue.end()) ==
+              std::vector<int>{7, 8, 9});
+    }
+}
@@ -0,0 +1,73 @@
+#include "../doctest.h"
+#include <numeric>
+#include <pre/memory>
+#include <thread>
+
+TEST_CASE("StaticSpscQueue") {
+    SUBCASE("Single thread") {
+        pre::StaticSpscQueue<int, 6> queue;
+
+        for (int k = 0; k < 6; k++) {
+            // Should not throw yet.
+            CHECK_NOTHROW(queue.push(k));
+        }
+
+        // Should now be full.
+        CHECK(queue.full());
+        // If full, push should throw.
+        CHECK_THROWS(queue.push(6));
+
+        // Pop half, then push across the end of the buffer.
+        int values[6] = {};
+        CHECK(queue.pop_n(std::span<int>(values, 3)) == 3);
+        CHECK(values[0] == 0);
+        CHECK(values[2] == 2);
+        int more[4] = {6, 7, 8, 9};
+        // Only 3 should fit.
+        CHECK(queue.push_n(more) == 3);
+        CHECK(queue.size() == 6);
+
+        // Pop should be least recently pushed, across the wrap.
+        CHECK(queue.pop_n(values) == 6);
+        for (int k = 0; k < 6; k++)
+            CHECK(values[k] == k + 3);
+
+        // Should now be empty.
+        CHECK(queue.empty());
+        // If empty, try pop should fail.
+        CHECK(!queue.try_pop());
+        // If empty, pop should throw.
+        CHECK_THROWS(queue.pop());
+    }
+    SUBCASE("Two threads") {
+        pre::StaticSpscQueue<int, 64> queue;
+        constexpr int Count = 100000;
+        std::thread producer([&] {
+            int values[7];
+            int next = 0;
+            while (next < Count) {
+                int count = std::min(7, Count - next);
+                std::iota(values, values + count, next);
+                size_t pushed =
+                        queue.push_n(std::span<const int>(values, count));
+                if (pushed == 0)
+                    std::this_thread::yield();
+                next += pushed;
+            }
+        });
+        // Every value should come out exactly once, in order.
+        bool in_order = true;
+        int next = 0;
+        int values[5];
+        while (next < Count) {
+            size_t count = queue.pop_n(values);
+            if (count == 0)
+                std::this_thread::yield();
+            for (size_t k = 0; k < count; k++)
+                in_order = in_order && values[k] == next++;
+        }
+        producer.join();
+        CHECK(in_order);
+        CHECK(queue.empty());
+    }
+}
@@ -0,0 +1,669 @@
+#include "../doctest.h"
+#include <cstdlib>
+#include <latch>
+#include <new>
+#include <numeric>
+#include <sstream>
+#include <pre/ThreadPool>
+
+// Count heap allocations, to check that submission is allocation-free.
+static std::atomic_size_t allocation_count = 0;
+
+void* operator new(size_t size) {
+    allocation_count++;
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+TEST_CASE("ThreadPool") {
+    pre::ThreadPool pool(4);
+    SUBCASE("Submit") {
+        std::vector<std::future<int>> futures;
+        for (int k = 0; k < 1000; k++)
+            futures.push_back(pool.submit([](int x) { return x * x; }, k));
+        for (int k = 0; k < 1000; k++)
+            CHECK(futures[k].get() == k * k);
+    }
+    SUBCASE("Submit from inside tasks") {
+        std::atomic_int count = 0;
+        for (int k = 0; k < 64; k++) {
+            pool.submit([&]() {
+                for (int j = 0; j < 64; j++)
+                    pool.submit([&]() { count++; });
+            });
+        }
+        pool.wait_all();
+        CHECK(count == 64 * 64);
+    }
+    SUBCASE("Submit with exception") {
+        auto future = pool.submit([]() { throw std::runtime_error("oops"); });
+        CHECK_THROWS_AS(future.get(), std::runtime_error);
+    }
+    SUBCASE("Submit with lvalue arguments") {
+        // Arguments are bound as lvalues, as with std::bind.
+        auto future = pool.submit(
+                [](std::vector<int>& values) {
+                    values.push_back(4);
+                    return values.size();
+                },
+                std::vector<int>{1, 2, 3});
+        CHECK(future.get() == 4);
+    }
+    SUBCASE("Post") {
+        std::atomic_int count = 0;
+        for (int k = 0; k < 1000; k++)
+            pool.post([&](int x) { count += x; }, 1);
+        pool.wait_all();
+        CHECK(count == 1000);
+    }
+    SUBCASE("Post large function object") {
+        // Too large to store inline, must go to the heap.
+        std::array<int, 64> values = {};
+        values[63] = 1;
+        std::atomic_int count = 0;
+        static_assert(!pre::ThreadPool::TaskFunc::is_inline<
+                      decltype([=, &count] { count += values[63]; })>);
+        for (int k = 0; k < 100; k++)
+            pool.post([=, &count] { count += values[63]; });
+        pool.wait_all();
+        CHECK(count == 100);
+    }
+    SUBCASE("Submit after idle") {
+        // Workers park when idle, so every submission must wake one.
+        for (int k = 0; k < 100; k++) {
+            if (k % 10 == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            CHECK(pool.submit([=]() { return k; }).get() == k);
+        }
+    }
+    SUBCASE("Wait all without tasks") {
+        pool.wait_all();
+        CHECK(true);
+    }
+}
+
+TEST_CASE("ThreadPool allocation-free submission") {
+    pre::ThreadPool pool(2);
+    std::vector<std::future<int>> futures;
+    futures.reserve(1000);
+    std::atomic_int count = 0;
+    auto run = [&] {
+        for (int k = 0; k < 1000; k++) {
+            futures.push_back(pool.submit([](int x) { return x * x; }, k));
+            pool.post([&](int x) { count += x; }, 1);
+        }
+        for (auto& future : futures)
+            future.get();
+        futures.clear();
+        pool.wait_all();
+    };
+    // Warm up, so that queues are grown and shared state blocks are
+    // cached, even with some stranded in worker caches.
+    for (int k = 0; k < 3; k++)
+        run();
+    size_t before = allocation_count.load();
+    run();
+    size_t after = allocation_count.load();
+    // Should not allocate once warmed up.
+    CHECK(after - before == 0);
+    CHECK(count == 4000);
+}
+
+TEST_CASE("ThreadPool with spinning") {
+    pre::ThreadPool pool(2, 1000);
+    std::atomic_int count = 0;
+    for (int k = 0; k < 100; k++) {
+        pool.submit([&]() { count++; });
+        if (k % 10 == 0)
+            pool.wait_all();
+    }
+    pool.wait_all();
+    CHECK(count == 100);
+}
+
+TEST_CASE("ThreadPool parallel algorithms") {
+    pre::ThreadPool pool(4);
+    SUBCASE("Tiling") {
+        pre::ParallelTiling<2> tiling(pre::MultiIndex(37, 53), 64);
+        CHECK(tiling.tile.prod() <= 64);
+        CHECK(tiling.tile[1] == 53);
+        int count = 0;
+        for (ssize_t pos = 0; pos < tiling.size(); pos++)
+            tiling.for_each(pos, [&](auto) { count++; });
+        CHECK(count == 37 * 53);
+    }
+    SUBCASE("Parallel for") {
+        pre::Array<int, 37, 53, 3> arr = {};
+        pre::parallel_for(
+                pool, arr.view(),
+                [](const pre::MultiIndex<3>& k, int& value) {
+                    value += k[0] * 1000 + k[1] * 10 + k[2];
+                },
+                16);
+        bool okay = true;
+        for (int i = 0; i < 37; i++)
+            for (int j = 0; j < 53; j++)
+                for (int k = 0; k < 3; k++)
+                    okay &= arr[i][j][k] == i * 1000 + j * 10 + k;
+        CHECK(okay);
+    }
+    SUBCASE("Parallel for from inside tasks") {
+        std::vector<int> values(4096);
+        auto future = pool.submit([&]() {
+            pre::parallel_for(
+                    pool, pre::ArrayView(values), [](int& value) { value++; },
+                    32);
+        });
+        future.get();
+        CHECK(std::count(values.begin(), values.end(), 1) == 4096);
+    }
+    SUBCASE("Parallel reduce is reproducible") {
+        std::vector<double> values(100000);
+        for (size_t k = 0; k < values.size(); k++)
+            values[k] = 1.0 / (1.0 + k);
+        auto sum = [&]() {
+            return pre::parallel_reduce(
+                    pool, pre::ArrayView(values), 0.0, std::plus<>(), 1000);
+        };
+        double sum0 = sum();
+        for (int repeat = 0; repeat < 10; repeat++)
+            CHECK(sum() == sum0);
+        CHECK(sum0 == doctest::Approx(std::accumulate(
+                              values.begin(), values.end(), 0.0)));
+    }
+    SUBCASE("NdArray") {
+        pre::NdArray<float> arr;
+        arr.resize(64, 32);
+        pre::parallel_for<2>(pool, arr, [](float& value) { value = 2; });
+        CHECK(pre::parallel_reduce(pool, arr, 0.0f, std::plus<>()) ==
+              64 * 32 * 2);
+    }
+    SUBCASE("Empty") {
+        CHECK(pre::parallel_reduce(
+                      pool, pre::ArrayView<int, 1>(), 7, std::plus<>()) ==
+              7);
+    }
+}
+
+TEST_CASE("TaskGraph") {
+    pre::ThreadPool pool(2);
+    SUBCASE("Diamonds") {
+        // Chain of diamonds, each diamond a -> (b, c) -> d.
+        std::vector<int> order;
+        std::mutex mutex;
+        pre::TaskGraph graph;
+        size_t prev = graph.add([] {});
+        for (int k = 0; k < 32; k++) {
+            auto record = [&, k](int which) {
+                return [&, k, which] {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    order.push_back(k * 4 + which);
+                };
+            };
+            size_t a = graph.add(record(0));
+            size_t b = graph.add(record(1));
+            size_t c = graph.add(record(2));
+            size_t d = graph.add(record(3));
+            graph.precede(prev, a);
+            graph.precede(a, b);
+            graph.precede(a, c);
+            graph.precede(b, d);
+            graph.precede(c, d);
+            prev = d;
+        }
+        for (int repeat = 0; repeat < 4; repeat++) {
+            order.clear();
+            graph.run(pool);
+            REQUIRE(order.size() == 32 * 4);
+            for (int k = 0; k < 32; k++) {
+                CHECK(order[k * 4 + 0] == k * 4 + 0);
+                CHECK(order[k * 4 + 3] == k * 4 + 3);
+            }
+        }
+    }
+    SUBCASE("Wide") {
+        std::atomic_int count = 0;
+        pre::TaskGraph graph;
+        size_t root = graph.add([] {});
+        size_t sink = graph.add([&] { CHECK(count == 256); });
+        for (int k = 0; k < 256; k++) {
+            size_t node = graph.add([&] { count++; });
+            graph.precede(root, node);
+            graph.precede(node, sink);
+        }
+        graph.run(pool);
+        CHECK(count == 256);
+    }
+    SUBCASE("Cycle") {
+        pre::TaskGraph graph;
+        size_t a = graph.add([] {});
+        size_t b = graph.add([] {});
+        graph.precede(a, b);
+        graph.precede(b, a);
+        CHECK_THROWS_AS(graph.run(pool), std::logic_error);
+    }
+    SUBCASE("Exception") {
+        bool ran = false;
+        pre::TaskGraph graph;
+        size_t a = graph.add([] { throw std::runtime_error("oops"); });
+        size_t b = graph.add([&] { ran = true; });
+        graph.precede(a, b);
+        CHECK_THROWS_AS(graph.run(pool), std::runtime_error);
+        CHECK(!ran);
+    }
+}
+
+TEST_CASE("TaskGroup") {
+    SUBCASE("Nested waits on a single worker") {
+        // With a blocking wait, this would deadlock.
+        pre::ThreadPool pool(1);
+        std::atomic_int count = 0;
+        auto future = pool.submit([&]() {
+            pre::TaskGroup group(pool);
+            for (int k = 0; k < 8; k++) {
+                group.post([&]() {
+                    pre::TaskGroup subgroup(pool);
+                    for (int j = 0; j < 8; j++)
+                        subgroup.post([&]() { count++; });
+                    subgroup.wait();
+                });
+            }
+            group.wait();
+            return count.load();
+        });
+        CHECK(future.get() == 64);
+    }
+    SUBCASE("Wait only on own tasks") {
+        pre::ThreadPool pool(2);
+        std::atomic_bool started = false;
+        std::atomic_bool release = false;
+        pool.post([&]() {
+            started = true;
+            while (!release)
+                std::this_thread::yield();
+        });
+        while (!started)
+            std::this_thread::yield();
+        pre::TaskGroup group(pool);
+        auto future = group.submit([](int x) { return x + 1; }, 1);
+        group.wait();
+        CHECK(group.done());
+        CHECK(future.wait_for(std::chrono::seconds(0)) ==
+              std::future_status::ready);
+        CHECK(future.get() == 2);
+        release = true;
+        pool.wait_all();
+    }
+    SUBCASE("Throw from posted task while helping") {
+        pre::ThreadPool pool(1);
+        std::atomic_bool started = false;
+        std::atomic_bool release = false;
+        pool.post([&]() {
+            started = true;
+            while (!release)
+                std::this_thread::yield();
+        });
+        while (!started)
+            std::this_thread::yield();
+        // The worker is busy, so the waiting thread runs the task, and
+        // the exception propagates to it.
+        pool.post([]() { throw std::runtime_error("oops"); });
+        CHECK_THROWS_AS(pool.wait_all(), std::runtime_error);
+        {
+            pre::TaskGroup group(pool);
+            group.post([]() { throw std::runtime_error("oops"); });
+            CHECK_THROWS_AS(group.wait(), std::runtime_error);
+            // Should count as complete, so waiting again returns.
+            CHECK(group.done());
+        }
+        release = true;
+        pool.wait_all();
+        CHECK(pool.run_pending() == false);
+    }
+}
+
+static pre::AsyncTask<int> async_square(pre::ThreadPool& pool, int x) {
+    co_return co_await pool.async([](int x) { return x * x; }, x);
+}
+
+static pre::AsyncTask<int> async_sum_of_squares(pre::ThreadPool& pool, int n) {
+    std::thread::id main_id = std::this_thread::get_id();
+    co_await pool.schedule();
+    CHECK(std::this_thread::get_id() != main_id);
+    int sum = 0;
+    for (int k = 0; k < n; k++)
+        sum += co_await async_square(pool, k);
+    co_return sum;
+}
+
+static pre::AsyncTask<> async_throw(pre::ThreadPool& pool) {
+    co_await pool.async([] { throw std::runtime_error("oops"); });
+}
+
+TEST_CASE("AsyncTask") {
+    pre::ThreadPool pool(2);
+    SUBCASE("Sync wait") {
+        CHECK(pre::sync_wait(async_sum_of_squares(pool, 10)) == 285);
+    }
+    SUBCASE("Exception") {
+        CHECK_THROWS_AS(pre::sync_wait(async_throw(pool)), std::runtime_error);
+    }
+    SUBCASE("Not started unless awaited") {
+        bool started = false;
+        // The lambda must outlive the coroutine, which refers to the
+        // lambda captures.
+        auto start = [&]() -> pre::AsyncTask<> {
+            started = true;
+            co_return;
+        };
+        auto task = start();
+        CHECK(!started);
+        pre::sync_wait(std::move(task));
+        CHECK(started);
+    }
+}
+
+TEST_CASE("ThreadPool placement") {
+    SUBCASE("Parse CPU list") {
+        auto cpus = pre::NumaTopology::parse_cpulist("0-3,8,10-11\n");
+        CHECK(cpus == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+    }
+    SUBCASE("Topology") {
+        const auto& topology = pre::NumaTopology::get();
+        REQUIRE(topology.size() > 0);
+        for (const auto& node : topology.nodes) {
+            CHECK(!node.cpus.empty());
+            CHECK(topology.node_of(node.cpus[0]) == node.id);
+        }
+    }
+    for (auto affinity :
+         {pre::ThreadPool::Affinity::None, pre::ThreadPool::Affinity::Core,
+          pre::ThreadPool::Affinity::NumaNode}) {
+        pre::ThreadPool pool({.count = 3, .affinity = affinity});
+        CHECK(pool.current_worker_index() == -1);
+        std::vector<std::future<int>> futures;
+        for (int k = 0; k < 32; k++)
+            futures.push_back(
+                    pool.submit([&] { return pool.current_worker_index(); }));
+        for (auto& future : futures) {
+            int index = future.get();
+            CHECK(index >= 0);
+            CHECK(index < 3);
+            if (affinity == pre::ThreadPool::Affinity::None)
+                CHECK(pool.worker_numa_node(index) == -1);
+#if __linux__
+            else
+                CHECK(pool.worker_numa_node(index) >= 0);
+#endif // #if __linux__
+        }
+    }
+}
+
+TEST_CASE("ThreadPool priorities") {
+    using Priority = pre::ThreadPool::Priority;
+    pre::ThreadPool pool(1);
+    std::atomic_bool started = false;
+    std::atomic_bool release = false;
+    auto block = [&] {
+        pool.post([&] {
+            started = true;
+            while (!release)
+                std::this_thread::yield();
+        });
+        while (!started)
+            std::this_thread::yield();
+    };
+    SUBCASE("Lanes") {
+        block();
+        std::vector<int> order;
+        std::latch done(6);
+        auto record = [&](int value) {
+            return [&, value] {
+                order.push_back(value);
+                done.count_down();
+            };
+        };
+        auto now = std::chrono::steady_clock::now();
+        pool.post(Priority::Low, record(4));
+        pool.post(Priority::Normal, record(3));
+        pool.post(record(3));
+        pool.post(Priority::High, record(2));
+        pool.post(now + std::chrono::seconds(2), record(1));
+        pool.post(now + std::chrono::seconds(1), record(0));
+        auto future = pool.submit(Priority::Low, [](int x) { return x; }, 5);
+        release = true;
+        // Wait without helping, so the worker is the only consumer and
+        // runs the tasks in queue order.
+        done.wait();
+        CHECK(order == std::vector<int>{0, 1, 2, 3, 3, 4});
+        CHECK(future.get() == 5);
+    }
+    SUBCASE("Aging") {
+        block();
+        std::vector<int> order;
+        std::latch done(33);
+        auto record = [&](int value) {
+            return [&, value] {
+                order.push_back(value);
+                done.count_down();
+            };
+        };
+        pool.post(Priority::Low, record(1));
+        for (int k = 0; k < 32; k++)
+            pool.post(Priority::High, record(0));
+        release = true;
+        done.wait();
+        REQUIRE(order.size() == 33);
+        CHECK(std::find(order.begin(), order.end(), 1) - order.begin() < 16);
+    }
+}
+
+TEST_CASE("ThreadPool bulk submission") {
+    pre::ThreadPool pool(4);
+    SUBCASE("Range") {
+        std::vector<int> values(10000);
+        std::iota(values.begin(), values.end(), 0);
+        std::atomic<long> sum = 0;
+        auto future = pool.submit_bulk(
+                values.begin(), values.end(), [&](int value) { sum += value; });
+        future.get();
+        CHECK(sum == 10000L * 9999L / 2);
+    }
+    SUBCASE("Empty range") {
+        std::vector<int> values;
+        auto future =
+                pool.submit_bulk(values.begin(), values.end(), [](int) {});
+        CHECK(future.wait_for(std::chrono::seconds(0)) ==
+              std::future_status::ready);
+    }
+    SUBCASE("Exception") {
+        std::vector<int> values(100);
+        std::iota(values.begin(), values.end(), 0);
+        auto future =
+                pool.submit_bulk(values.begin(), values.end(), [](int value) {
+                    if (value == 42)
+                        throw std::runtime_error("42");
+                });
+        CHECK_THROWS_AS(future.get(), std::runtime_error);
+    }
+    SUBCASE("From a worker") {
+        std::vector<int> values(1000, 1);
+        std::atomic_int count = 0;
+        pool.post([&] {
+            pool.submit_bulk(
+                    values.begin(), values.end(),
+                    [&](int value) { count += value; },
+                    pre::ThreadPool::Priority::Low);
+        });
+        pool.wait_all();
+        CHECK(count == 1000);
+    }
+    SUBCASE("Shutdown before running") {
+        std::vector<int> values(100);
+        std::future<void> future;
+        {
+            pre::ThreadPool other(1);
+            other.shutdown();
+            future = other.submit_bulk(
+                    values.begin(), values.end(), [](int) {});
+        }
+        // Dropped tasks should break the promise, not leak it.
+        CHECK_THROWS_AS(future.get(), std::future_error);
+    }
+}
+
+TEST_CASE("ThreadPool metrics") {
+    SUBCASE("Histogram") {
+        pre::DurationHistogram histogram;
+        CHECK(histogram.bucket_of(0) == 0);
+        CHECK(histogram.bucket_of(1) == 1);
+        CHECK(histogram.bucket_of(1000) == 10);
+        CHECK(histogram.bucket_of(uint64_t(-1)) == 39);
+        histogram.counts[3] = 90;
+        histogram.counts[10] = 10;
+        CHECK(histogram.total() == 100);
+        CHECK(histogram.quantile(0.5) == std::chrono::nanoseconds(8));
+        CHECK(histogram.quantile(0.95) == std::chrono::nanoseconds(1024));
+    }
+    SUBCASE("Disabled") {
+        pre::ThreadPool pool(2);
+        pool.post([] {});
+        pool.wait_all();
+        auto metrics = pool.metrics();
+        CHECK(metrics.workers.size() == 2);
+        CHECK(metrics.latency.total() == 0);
+        std::ostringstream stream;
+        pool.write_trace(stream);
+        CHECK(stream.str() == "{\"traceEvents\":[\n]}\n");
+    }
+    SUBCASE("Enabled") {
+        pre::ThreadPool pool({.count = 2, .trace_capacity = 16});
+        for (int k = 0; k < 64; k++)
+            pool.post([] {});
+        std::vector<int> values(64);
+        pool.submit_bulk(values.begin(), values.end(), [](int) {}).get();
+        pool.wait_all();
+        auto metrics = pool.metrics();
+        // Helping threads may have run some tasks too.
+        uint64_t run_count = metrics.helpers.run_count;
+        for (const auto& worker : metrics.workers) {
+            run_count += worker.run_count;
+            CHECK(worker.steal_count <= worker.run_count);
+        }
+        CHECK(run_count == 128);
+        CHECK(metrics.latency.total() == 128);
+        CHECK(metrics.duration.total() == 128);
+        std::ostringstream stream;
+        pool.write_trace(stream);
+        std::string trace = stream.str();
+        CHECK(trace.find("\"ph\":\"X\"") != std::string::npos);
+        CHECK(trace.find("\"name\":\"worker 1\"") != std::string::npos);
+        CHECK(trace.find("\"name\":\"helpers\"") != std::string::npos);
+    }
+    SUBCASE("Helpers") {
+        pre::ThreadPool pool({.count = 1, .metrics = true});
+        std::atomic_bool started = false;
+        std::atomic_bool release = false;
+        pool.post([&] {
+            started = true;
+            while (!release)
+                std::this_thread::yield();
+        });
+        while (!started)
+            std::this_thread::yield();
+        // The worker is busy, so the waiting thread runs these.
+        for (int k = 0; k < 16; k++)
+            pool.post([] {});
+        pre::TaskGroup group(pool);
+        group.post([] {});
+        group.wait();
+        while (pool.run_pending())
+            continue;
+        release = true;
+        pool.wait_all();
+        auto metrics = pool.metrics();
+        CHECK(metrics.helpers.run_count == 17);
+        CHECK(metrics.workers[0].run_count == 1);
+        CHECK(metrics.latency.total() == 18);
+    }
+}
+
+TEST_CASE("ThreadPool resizing") {
+    auto wait_for_size = [](pre::ThreadPool& pool, size_t n) {
+        for (int k = 0; k < 1000 && pool.size() != n; k++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        return pool.size() == n;
+    };
+    SUBCASE("Explicit") {
+        pre::ThreadPool pool({.count = 2, .max_count = 4});
+        CHECK(pool.size() == 2);
+        CHECK(pool.max_size() == 4);
+        CHECK_THROWS_AS(pool.resize(0), std::invalid_argument);
+        CHECK_THROWS_AS(pool.resize(5), std::invalid_argument);
+        for (size_t n : {4, 1, 3, 1, 4, 2}) {
+            pool.resize(n);
+            CHECK(pool.size() == n);
+            std::atomic_int count = 0;
+            for (int k = 0; k < 1000; k++)
+                pool.post([&] { count++; });
+            pool.wait_all();
+            CHECK(count == 1000);
+        }
+    }
+    SUBCASE("Shrink from inside a task") {
+        pre::ThreadPool pool({.count = 4});
+        std::atomic_int count = 0;
+        for (int k = 0; k < 1000; k++)
+            pool.post([&] {
+                if (++count == 500)
+                    pool.resize(1);
+            });
+        pool.wait_all();
+        CHECK(count == 1000);
+        CHECK(pool.size() == 1);
+    }
+    SUBCASE("Grow under pressure and reap when idle") {
+        pre::ThreadPool pool(
+                {.count = 1,
+                 .max_count = 4,
+                 .pressure_threshold = 2,
+                 .idle_timeout = std::chrono::milliseconds(20)});
+        std::atomic_bool release = false;
+        for (int k = 0; k < 64; k++)
+            pool.post([&] {
+                while (!release)
+                    std::this_thread::yield();
+            });
+        CHECK(pool.size() == 4);
+        release = true;
+        pool.wait_all();
+        CHECK(wait_for_size(pool, 1));
+    }
+}
+
+TEST_CASE("ThreadPool injection queue") {
+    pre::ThreadPool pool({.count = 3, .injection = true});
+    std::atomic_int count = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&] {
+            // More than the injection queue holds, to exercise fallback.
+            for (int k = 0; k < 3000; k++)
+                pool.post([&] { count++; });
+        });
+    for (auto& thread : threads)
+        thread.join();
+    auto future = pool.submit(pre::ThreadPool::Priority::High, [] { return 1; });
+    pool.wait_all();
+    CHECK(count == 12000);
+    CHECK(future.get() == 1);
+}
@@ -0,0 +1,207 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+template <typename Value>
+class AsyncTask;
+
+template <typename Value>
+struct AsyncTaskPromiseResult {
+    void return_value(Value value) {
+        result.template emplace<1>(std::move(value));
+    }
+
+    Value get() {
+        if (result.index() == 2)
+            std::rethrow_exception(std::get<2>(result));
+        return std::move(std::get<1>(result));
+    }
+
+    std::variant<std::monostate, Value, std::exception_ptr> result = {};
+};
+
+template <>
+struct AsyncTaskPromiseResult<void> {
+    void return_void() noexcept {
+    }
+
+    void get() {
+        if (result.index() == 2)
+            std::rethrow_exception(std::get<2>(result));
+    }
+
+    std::variant<std::monostate, std::monostate, std::exception_ptr> result =
+            {};
+};
+
+/// An asynchronous task, as a coroutine.
+///
+/// The coroutine is lazy, meaning it does not start until awaited.
+/// Awaiting transfers control directly into the coroutine, and when the
+/// coroutine finishes, control transfers directly back to the awaiting
+/// coroutine, on whichever thread the task finished on. Inside the
+/// coroutine, use `co_await pool.schedule()` to hop onto a worker, and
+/// `co_await pool.async(func)` to run a function object on a worker
+/// without blocking. To drive a task from ordinary code, use
+/// `sync_wait()`.
+///
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~{.cpp}
+/// pre::AsyncTask<int> compute(pre::ThreadPool& pool) {
+///     co_await pool.schedule();
+///     int x = co_await pool.async([] { return 42; });
+///     co_return x + 1;
+/// }
+/// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+///
+template <typename Value = void>
+class AsyncTask {
+  public:
+    struct promise_type : AsyncTaskPromiseResult<Value> {
+        AsyncTask get_return_object() noexcept {
+            return AsyncTask(Handle::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        auto final_suspend() noexcept {
+            struct FinalAwaitable {
+                bool await_ready() const noexcept {
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+                    return handle.promise().continuation;
+                }
+
+                void await_resume() const noexcept {
+                }
+            };
+            return FinalAwaitable{};
+        }
+
+        void unhandled_exception() noexcept {
+            this->result.template emplace<2>(std::current_exception());
+        }
+
+        /// Continuation, to resume on completion.
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+  public:
+    AsyncTask() noexcept = default;
+
+    AsyncTask(const AsyncTask&) = delete;
+
+    AsyncTask(AsyncTask&& other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr)) {
+    }
+
+    ~AsyncTask() {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    AsyncTask& operator=(const AsyncTask&) = delete;
+
+    AsyncTask& operator=(AsyncTask&& other) noexcept {
+        if (this != &other) {
+            if (handle_)
+                handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+  public:
+    /// Is done?
+    bool done() const noexcept {
+        return !handle_ || handle_.done();
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaitable {
+            bool await_ready() const noexcept {
+                return !handle || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<> continuation) noexcept {
+                handle.promise().continuation = continuation;
+                return handle;
+            }
+
+            Value await_resume() {
+                return handle.promise().get();
+            }
+
+            Handle handle;
+        };
+        return Awaitable{handle_};
+    }
+
+  private:
+    explicit AsyncTask(Handle handle) noexcept : handle_(handle) {
+    }
+
+    Handle handle_ = nullptr;
+};
+
+/// A detached coroutine, which destroys itself on completion.
+struct AsyncDetached {
+    struct promise_type {
+        AsyncDetached get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {
+        }
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+/// Start asynchronous task and block the calling thread until done.
+///
+/// \note
+/// Blocking defeats the purpose inside a worker, so this is meant
+/// for the top level, such as `main()`.
+///
+/// \throw  Whatever the task throws.
+///
+template <typename Value>
+inline Value sync_wait(AsyncTask<Value> task) {
+    std::promise<Value> promise;
+    std::future<Value> future = promise.get_future();
+    [](AsyncTask<Value> task, std::promise<Value> promise) -> AsyncDetached {
+        try {
+            if constexpr (std::is_void_v<Value>) {
+                co_await std::move(task);
+                promise.set_value();
+            }
+            else {
+                promise.set_value(co_await std::move(task));
+            }
+        }
+        catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    }(std::move(task), std::move(promise));
+    return future.get();
+}
+
+} // namespace pre
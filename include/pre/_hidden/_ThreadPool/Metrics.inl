@@ -0,0 +1,105 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A histogram of durations, with power-of-2 nanosecond buckets.
+struct DurationHistogram {
+  public:
+    /// Bucket count.
+    static constexpr size_t BucketCount = 40;
+
+    /// Bucket counts.
+    ///
+    /// Bucket 0 counts durations of 0ns, and bucket \f$ k > 0 \f$ counts
+    /// durations in \f$ [2^{k-1}, 2^k) \f$ ns. The last bucket also counts
+    /// everything longer, which is about 9 minutes.
+    ///
+    std::array<uint64_t, BucketCount> counts = {};
+
+  public:
+    /// Bucket index of given duration in nanoseconds.
+    static constexpr size_t bucket_of(uint64_t nanos) noexcept {
+        return std::min<size_t>(std::bit_width(nanos), BucketCount - 1);
+    }
+
+    /// Total count.
+    uint64_t total() const noexcept {
+        uint64_t res = 0;
+        for (uint64_t count : counts)
+            res += count;
+        return res;
+    }
+
+    /// Approximate quantile.
+    ///
+    /// \param[in] q
+    /// Quantile in \f$ [0, 1] \f$, e.g., 0.99 for the 99th percentile.
+    ///
+    /// \returns
+    /// Upper bound of the bucket containing the quantile, or 0 if empty.
+    ///
+    std::chrono::nanoseconds quantile(double q) const noexcept {
+        uint64_t target = q * total();
+        uint64_t count = 0;
+        for (size_t index = 0; index < BucketCount; index++) {
+            count += counts[index];
+            if (count > target)
+                return std::chrono::nanoseconds(uint64_t(1) << index);
+        }
+        return std::chrono::nanoseconds(0);
+    }
+
+    DurationHistogram& operator+=(const DurationHistogram& other) noexcept {
+        for (size_t index = 0; index < BucketCount; index++)
+            counts[index] += other.counts[index];
+        return *this;
+    }
+};
+
+/// A snapshot of thread pool metrics.
+struct ThreadPoolMetrics {
+  public:
+    /// Metrics of one worker.
+    struct Worker {
+        /// Number of tasks in the queue of this worker.
+        size_t queue_size = 0;
+
+        /// Number of tasks run.
+        uint64_t run_count = 0;
+
+        /// Number of tasks run that were stolen from other queues.
+        uint64_t steal_count = 0;
+
+        /// Number of times parked.
+        uint64_t park_count = 0;
+
+        /// Total time spent running tasks.
+        std::chrono::nanoseconds run_time = {};
+
+        /// Total time spent parked.
+        std::chrono::nanoseconds park_time = {};
+
+        /// Histogram of latency, from enqueue to start.
+        DurationHistogram latency = {};
+
+        /// Histogram of execution time.
+        DurationHistogram duration = {};
+    };
+
+    /// Workers.
+    std::vector<Worker> workers = {};
+
+    /// Tasks run by threads helping in a wait, e.g., in
+    /// `ThreadPool::wait_all()`, which are not workers. Helpers have no
+    /// queue and never park, so only the task counters apply.
+    Worker helpers = {};
+
+    /// Histogram of latency over all workers and helpers.
+    DurationHistogram latency = {};
+
+    /// Histogram of execution time over all workers and helpers.
+    DurationHistogram duration = {};
+};
+
+} // namespace pre
@@ -0,0 +1,161 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A NUMA topology, as seen by the calling process.
+///
+/// On Linux, this reads the CPU list of each node from sysfs, and keeps
+/// only the CPUs the process is allowed to run on, according to
+/// `sched_getaffinity()`. Elsewhere, or if sysfs is not available, this
+/// is a single node with every CPU.
+///
+struct NumaTopology {
+  public:
+    /// A node.
+    struct Node {
+        /// Node ID, as in `/sys/devices/system/node/node<id>`.
+        int id = 0;
+
+        /// CPU IDs.
+        std::vector<int> cpus = {};
+    };
+
+    /// Nodes, sorted by ID, none of which are empty.
+    std::vector<Node> nodes = {};
+
+  public:
+    /// Node count.
+    size_t size() const noexcept {
+        return nodes.size();
+    }
+
+    /// All CPU IDs, in node order.
+    std::vector<int> cpus() const {
+        std::vector<int> res;
+        for (const Node& node : nodes)
+            res.insert(res.end(), node.cpus.begin(), node.cpus.end());
+        return res;
+    }
+
+    /// Node ID of given CPU ID, or -1 if unknown.
+    int node_of(int cpu) const noexcept {
+        for (const Node& node : nodes)
+            if (std::find(node.cpus.begin(), node.cpus.end(), cpu) !=
+                node.cpus.end())
+                return node.id;
+        return -1;
+    }
+
+  public:
+    /// Get topology, loaded once and cached.
+    static const NumaTopology& get() {
+        static const NumaTopology topology = load();
+        return topology;
+    }
+
+    /// Load topology.
+    static NumaTopology load() {
+        NumaTopology topology;
+        std::vector<int> allowed = allowed_cpus();
+#if __linux__
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(
+                     "/sys/devices/system/node", error)) {
+            std::string name = entry.path().filename().string();
+            if (!(name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                  std::all_of(name.begin() + 4, name.end(), [](char ch) {
+                      return '0' <= ch && ch <= '9';
+                  })))
+                continue;
+            std::ifstream stream(entry.path() / "cpulist");
+            std::string cpulist;
+            if (!std::getline(stream, cpulist))
+                continue;
+            Node node;
+            node.id = std::stoi(name.substr(4));
+            for (int cpu : parse_cpulist(cpulist))
+                if (std::find(allowed.begin(), allowed.end(), cpu) !=
+                    allowed.end())
+                    node.cpus.push_back(cpu);
+            if (!node.cpus.empty())
+                topology.nodes.push_back(std::move(node));
+        }
+        std::sort(
+                topology.nodes.begin(), topology.nodes.end(),
+                [](const Node& lhs, const Node& rhs) {
+                    return lhs.id < rhs.id;
+                });
+#endif // #if __linux__
+        if (topology.nodes.empty())
+            topology.nodes.push_back({0, std::move(allowed)});
+        return topology;
+    }
+
+    /// Parse CPU list, in sysfs format, like `0-3,8,10-11`.
+    static std::vector<int> parse_cpulist(const std::string& str) {
+        std::vector<int> res;
+        size_t pos = 0;
+        while (pos < str.size()) {
+            size_t end = str.find(',', pos);
+            if (end == std::string::npos)
+                end = str.size();
+            std::string part = str.substr(pos, end - pos);
+            size_t dash = part.find('-');
+            try {
+                int first = std::stoi(part.substr(0, dash));
+                int last = dash == std::string::npos
+                                   ? first
+                                   : std::stoi(part.substr(dash + 1));
+                for (int cpu = first; cpu <= last; cpu++)
+                    res.push_back(cpu);
+            }
+            catch (const std::exception&) {
+                // Ignore garbage, like a trailing newline.
+            }
+            pos = end + 1;
+        }
+        return res;
+    }
+
+    /// CPU IDs the calling process is allowed to run on.
+    static std::vector<int> allowed_cpus() {
+        std::vector<int> res;
+#if __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                if (CPU_ISSET(cpu, &set))
+                    res.push_back(cpu);
+        }
+#endif // #if __linux__
+        if (res.empty()) {
+            int count = std::thread::hardware_concurrency();
+            for (int cpu = 0; cpu < count; cpu++)
+                res.push_back(cpu);
+        }
+        return res;
+    }
+
+    /// Restrict the calling thread to given CPU IDs.
+    ///
+    /// \returns
+    /// Returns true if successful. Always returns false if not on Linux.
+    ///
+    static bool set_thread_affinity(const std::vector<int>& cpus) {
+#if __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            if (0 <= cpu && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        return !cpus.empty() && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        static_cast<void>(cpus);
+        return false;
+#endif // #if __linux__
+    }
+};
+
+} // namespace pre
@@ -0,0 +1,197 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A task graph.
+///
+/// A directed acyclic graph of tasks to run on a thread pool. Declare
+/// the nodes and edges once, then run the graph as many times as needed.
+/// Each node is posted to the pool as soon as its last predecessor
+/// finishes, so no worker ever blocks waiting on a dependency. When a
+/// node finishes and releases more than one successor, the worker
+/// continues with one successor directly and posts the rest.
+///
+/// \note
+/// If a node throws, the exception is rethrown by `wait()` (or `run()`),
+/// and nodes that have not started yet are skipped. Only the first
+/// exception is kept.
+///
+class TaskGraph {
+  public:
+    TaskGraph() = default;
+
+    TaskGraph(const TaskGraph&) = delete;
+
+    ~TaskGraph() {
+        group_.reset(); // Wait.
+    }
+
+  public:
+    /// Number of nodes.
+    size_t size() const noexcept {
+        return nodes_.size();
+    }
+
+    /// Add node, returning its index.
+    ///
+    /// \throw std::logic_error  If running.
+    ///
+    template <typename Func>
+    size_t add(Func&& func) {
+        if (group_)
+            throw std::logic_error(__func__);
+        nodes_.push_back({ThreadPool::TaskFunc(std::forward<Func>(func))});
+        is_valid_ = false;
+        return nodes_.size() - 1;
+    }
+
+    /// Add edge, such that node `from` must finish before node `to` starts.
+    ///
+    /// \throw std::logic_error  If running.
+    /// \throw std::out_of_range  If either node index is out of range.
+    ///
+    void precede(size_t from, size_t to) {
+        if (group_)
+            throw std::logic_error(__func__);
+        if (!(from < nodes_.size() && to < nodes_.size()))
+            throw std::out_of_range(__func__);
+        nodes_[from].successors.push_back(to);
+        nodes_[to].predecessor_count++;
+        is_valid_ = false;
+    }
+
+    /// Start running on given pool, without waiting.
+    ///
+    /// \throw std::logic_error  If already running, or if the graph
+    /// has a cycle.
+    ///
+    void start(ThreadPool& pool) {
+        if (group_)
+            throw std::logic_error(__func__);
+        if (!is_valid_)
+            validate_();
+        if (nodes_.empty())
+            return;
+        group_.emplace(pool);
+        error_ = nullptr;
+        is_cancelled_ = false;
+        for (size_t index = 0; index < nodes_.size(); index++)
+            pending_[index] = nodes_[index].predecessor_count;
+        for (size_t index = 0; index < nodes_.size(); index++)
+            if (nodes_[index].predecessor_count == 0)
+                group_->post([this, index] { run_node_(index); });
+    }
+
+    /// Is done running?
+    bool done() const noexcept {
+        return !group_ || group_->done();
+    }
+
+    /// Wait until done, running pending pool tasks in the meantime.
+    ///
+    /// \throw  The first exception thrown by any node, if any.
+    ///
+    void wait() {
+        if (group_) {
+            group_.reset(); // Wait.
+            if (error_)
+                std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+    /// Run on given pool and wait until done.
+    void run(ThreadPool& pool) {
+        start(pool);
+        wait();
+    }
+
+  private:
+    struct Node {
+        /// Function.
+        ThreadPool::TaskFunc func;
+
+        /// Successor indexes.
+        std::vector<size_t> successors = {};
+
+        /// Predecessor count.
+        size_t predecessor_count = 0;
+    };
+
+    std::vector<Node> nodes_;
+
+    /// Pending predecessor counts, one per node, for the current run.
+    std::unique_ptr<std::atomic_size_t[]> pending_;
+
+    /// Task group of the current run, if running.
+    std::optional<TaskGroup> group_;
+
+    /// First exception of the current run.
+    std::exception_ptr error_ = nullptr;
+
+    std::mutex error_mutex_;
+
+    std::atomic_bool is_cancelled_ = false;
+
+    /// Validated since last modification?
+    bool is_valid_ = true;
+
+  private:
+    /// Check for cycles, and allocate pending counts.
+    ///
+    /// \throw std::logic_error  If the graph has a cycle.
+    ///
+    void validate_() {
+        // Kahn's algorithm.
+        std::vector<size_t> counts(nodes_.size());
+        std::vector<size_t> ready;
+        for (size_t index = 0; index < nodes_.size(); index++)
+            if ((counts[index] = nodes_[index].predecessor_count) == 0)
+                ready.push_back(index);
+        size_t visited = 0;
+        while (!ready.empty()) {
+            size_t index = ready.back();
+            ready.pop_back();
+            visited++;
+            for (size_t next : nodes_[index].successors)
+                if (--counts[next] == 0)
+                    ready.push_back(next);
+        }
+        if (visited != nodes_.size())
+            throw std::logic_error(__func__);
+        pending_ = std::make_unique<std::atomic_size_t[]>(nodes_.size());
+        is_valid_ = true;
+    }
+
+    /// Run node, then release its successors.
+    void run_node_(size_t index) {
+        while (true) {
+            if (!is_cancelled_.load(std::memory_order_relaxed)) {
+                try {
+                    nodes_[index].func();
+                }
+                catch (...) {
+                    std::unique_lock<std::mutex> lock(error_mutex_);
+                    if (!error_)
+                        error_ = std::current_exception();
+                    is_cancelled_ = true;
+                }
+            }
+            size_t next = size_t(-1);
+            for (size_t each : nodes_[index].successors) {
+                if (pending_[each].fetch_sub(1, std::memory_order_acq_rel) ==
+                    1) {
+                    if (next == size_t(-1))
+                        next = each; // Continue with this one directly.
+                    else
+                        group_->post([this, each] { run_node_(each); });
+                }
+            }
+            if (next == size_t(-1))
+                return;
+            index = next;
+        }
+    }
+};
+
+} // namespace pre
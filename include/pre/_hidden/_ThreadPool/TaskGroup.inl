@@ -0,0 +1,99 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A task group.
+///
+/// A scoped set of tasks submitted to a thread pool, which can be waited
+/// on independently of everything else in the pool. Waiting helps, meaning
+/// the waiting thread runs pending tasks (from the group or not) until
+/// the group is done, so it is safe and efficient to wait on a group from
+/// inside another task.
+///
+/// \note
+/// The destructor waits, so tasks never outlive the group.
+///
+class TaskGroup {
+  public:
+    TaskGroup(ThreadPool& pool) noexcept : pool_(pool) {
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+
+    ~TaskGroup() {
+        wait();
+    }
+
+  public:
+    /// Thread pool.
+    ThreadPool& pool() noexcept {
+        return pool_;
+    }
+
+    /// Number of incomplete tasks.
+    size_t size() const noexcept {
+        return count_.load();
+    }
+
+    /// Is done? (All tasks complete?)
+    bool done() const noexcept {
+        return count_.load() == 0;
+    }
+
+    /// Submit task, as with `ThreadPool::submit()`.
+    template <typename Func, typename... Args>
+    inline auto submit(Func&& func, Args&&... args) {
+        auto [task, future] = ThreadPool::package_(
+                std::forward<Func>(func), //
+                std::forward<Args>(args)...);
+        count_++;
+        pool_.push_([this, task = std::move(task)]() mutable {
+            task();
+            finish_();
+        });
+        return std::move(future);
+    }
+
+    /// Post task, as with `ThreadPool::post()`.
+    template <typename Func, typename... Args>
+    inline void post(Func&& func, Args&&... args) {
+        count_++;
+        pool_.push_([this, func = std::forward<Func>(func),
+                     ... args = std::forward<Args>(args)]() mutable {
+            try {
+                std::invoke(func, args...);
+            }
+            catch (...) {
+                finish_();
+                throw;
+            }
+            finish_();
+        });
+    }
+
+    /// Wait until all tasks complete, running pending tasks meanwhile.
+    ///
+    /// \note
+    /// If a posted task run by the calling thread throws, the exception
+    /// propagates, see `ThreadPool::post()`. Waiting again is safe.
+    ///
+    void wait() {
+        pool_.help_until_([&] { return done(); });
+    }
+
+  private:
+    ThreadPool& pool_;
+
+    std::atomic_size_t count_ = {};
+
+    void finish_() {
+        // The group may be destroyed as soon as the count reaches zero,
+        // so do not touch this afterward.
+        ThreadPool& pool = pool_;
+        if (--count_ == 0)
+            pool.wake_helpers_();
+    }
+};
+
+} // namespace pre
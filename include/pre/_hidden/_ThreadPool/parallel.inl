@@ -0,0 +1,256 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A tiling of a multi-dimensional iteration space.
+///
+/// The iteration space is cut into tiles of at most `grain` indexes.
+/// To keep tiles contiguous in row-major order, the outermost dimensions
+/// are halved first, and inner dimensions are only cut once the outer
+/// tile sizes reach 1. The tiling depends only on the sizes and the
+/// grain, never on the number of threads, so anything computed per tile
+/// is reproducible between runs.
+///
+template <size_t Rank>
+struct ParallelTiling {
+  public:
+    constexpr ParallelTiling(const MultiIndex<Rank>& sz, ssize_t grain)
+        : sizes(sz) {
+        if (sizes.prod() <= 0)
+            return;
+        if (grain < 1)
+            grain = 1;
+        tile = sizes;
+        for (size_t dim = 0; dim < Rank; dim++)
+            while (tile.prod() > grain && tile[dim] > 1)
+                tile[dim] = (tile[dim] + 1) / 2;
+        for (size_t dim = 0; dim < Rank; dim++)
+            counts[dim] = (sizes[dim] + tile[dim] - 1) / tile[dim];
+    }
+
+  public:
+    /// Tile count.
+    constexpr ssize_t size() const noexcept {
+        return counts.prod();
+    }
+
+    /// Call functor for each multi-index in given tile, in row-major order.
+    template <typename Func>
+    constexpr void for_each(ssize_t pos, Func&& func) const {
+        MultiIndex<Rank> from;
+        MultiIndex<Rank> to;
+        for (size_t dim = Rank; dim-- > 0;) {
+            from[dim] = (pos % counts[dim]) * tile[dim];
+            to[dim] = std::min(from[dim] + tile[dim], sizes[dim]);
+            pos /= counts[dim];
+        }
+        MultiIndex<Rank> k = from;
+        while (true) {
+            std::invoke(func, k);
+            size_t dim = Rank;
+            while (dim-- > 0) {
+                if (++k[dim] < to[dim])
+                    break;
+                k[dim] = from[dim];
+            }
+            if (dim == size_t(-1))
+                return;
+        }
+    }
+
+  public:
+    /// Iteration space sizes.
+    MultiIndex<Rank> sizes = {};
+
+    /// Tile sizes.
+    MultiIndex<Rank> tile = {};
+
+    /// Tile counts.
+    MultiIndex<Rank> counts = {};
+};
+
+/// Default grain for given value type, such that a tile of values
+/// fits comfortably in L1 cache.
+template <typename Value>
+constexpr ssize_t parallel_default_grain() noexcept {
+    return std::max(ssize_t(1), ssize_t(16384 / sizeof(Value)));
+}
+
+/// Run `func(pos)` for every tile position in `[0, count)` on a pool.
+///
+/// This is lazy binary splitting: whoever holds a range of tiles
+/// splits off the upper half for others to steal, but only while its
+/// own queue is empty, meaning nobody has anything to steal yet.
+/// Otherwise it just keeps processing tiles one by one. The calling
+/// thread participates, then waits on a `TaskGroup`, which helps run
+/// pending tasks, so this is safe to call from inside a task.
+///
+/// \note
+/// The function must not throw.
+///
+template <typename Func>
+inline void parallel_tiles(ThreadPool& pool, ssize_t count, Func&& func) {
+    if (count <= 0)
+        return;
+    struct Range {
+        TaskGroup* group;
+        Func* func;
+        void operator()(ssize_t from, ssize_t to) const {
+            while (from < to) {
+                if (to - from > 1 && group->pool().local_size() == 0) {
+                    ssize_t mid = from + (to - from) / 2;
+                    group->post([range = *this, mid, to] { range(mid, to); });
+                    to = mid;
+                }
+                else {
+                    std::invoke(*func, from++);
+                }
+            }
+        }
+    };
+    TaskGroup group(pool);
+    Range{&group, &func}(0, count);
+    group.wait();
+}
+
+/// Parallel for.
+///
+/// Calls `func(value)` or `func(k, value)` for every multi-index `k`
+/// in the view, where `value` is `view[k]`.
+///
+/// \param[in] pool
+/// Thread pool.
+///
+/// \param[in] view
+/// View.
+///
+/// \param[in] func
+/// Function, which must not throw.
+///
+/// \param[in] grain
+/// Maximum number of values per tile. If less than 1, uses
+/// `parallel_default_grain<Value>()`.
+///
+template <typename Value, size_t Rank, typename Func>
+inline void parallel_for(
+        ThreadPool& pool,
+        ArrayView<Value, Rank> view,
+        Func&& func,
+        ssize_t grain = 0) {
+    if (grain < 1)
+        grain = parallel_default_grain<Value>();
+    ParallelTiling<Rank> tiling(view.sizes, grain);
+    parallel_tiles(pool, tiling.size(), [&](ssize_t pos) {
+        tiling.for_each(pos, [&](const MultiIndex<Rank>& k) {
+            if constexpr (std::invocable<Func&, const MultiIndex<Rank>&, Value&>)
+                std::invoke(func, k, view[k]);
+            else
+                std::invoke(func, view[k]);
+        });
+    });
+}
+
+/// Parallel for over array, treated as a rank-`Rank` view.
+///
+/// \note
+/// If `Rank` is 1, the array is treated as flat, regardless of
+/// its actual rank.
+///
+template <size_t Rank = 1, typename Value, typename Alloc, typename Func>
+inline void parallel_for(
+        ThreadPool& pool,
+        NdArray<Value, Alloc>& arr,
+        Func&& func,
+        ssize_t grain = 0) {
+    if constexpr (Rank == 1)
+        parallel_for(
+                pool, ArrayView<Value, 1>(arr.data(), arr.size()),
+                std::forward<Func>(func), grain);
+    else
+        parallel_for(
+                pool, arr.template view<Rank>(), std::forward<Func>(func),
+                grain);
+}
+
+/// Parallel reduce.
+///
+/// Reduces every value in the view with `op`, which must be associative.
+/// Each tile is reduced sequentially, in row-major order, starting from
+/// its first value. The per-tile results are then reduced on the
+/// calling thread, in tile order, starting from `init`. Because the
+/// tiling does not depend on the number of threads or on scheduling,
+/// the result is reproducible between runs, even for floating point.
+///
+/// \param[in] pool
+/// Thread pool.
+///
+/// \param[in] view
+/// View.
+///
+/// \param[in] init
+/// Initial value.
+///
+/// \param[in] op
+/// Operation, invoked as `op(result, value)` and `op(result, result)`.
+/// It must not throw.
+///
+/// \param[in] grain
+/// Maximum number of values per tile. If less than 1, uses
+/// `parallel_default_grain<Value>()`.
+///
+template <typename Value, size_t Rank, typename Result, typename Op>
+inline Result parallel_reduce(
+        ThreadPool& pool,
+        ArrayView<Value, Rank> view,
+        Result init,
+        Op&& op,
+        ssize_t grain = 0) {
+    if (grain < 1)
+        grain = parallel_default_grain<Value>();
+    ParallelTiling<Rank> tiling(view.sizes, grain);
+    std::vector<std::optional<Result>> partials(
+            std::max(tiling.size(), ssize_t(0)));
+    parallel_tiles(pool, tiling.size(), [&](ssize_t pos) {
+        std::optional<Result>& partial = partials[pos];
+        tiling.for_each(pos, [&](const MultiIndex<Rank>& k) {
+            if (partial)
+                *partial = std::invoke(op, std::move(*partial), view[k]);
+            else
+                partial.emplace(view[k]);
+        });
+    });
+    for (std::optional<Result>& partial : partials)
+        init = std::invoke(op, std::move(init), std::move(*partial));
+    return init;
+}
+
+/// Parallel reduce over array, treated as a rank-`Rank` view.
+///
+/// \note
+/// If `Rank` is 1, the array is treated as flat, regardless of
+/// its actual rank.
+///
+template <
+        size_t Rank = 1,
+        typename Value,
+        typename Alloc,
+        typename Result,
+        typename Op>
+inline Result parallel_reduce(
+        ThreadPool& pool,
+        const NdArray<Value, Alloc>& arr,
+        Result init,
+        Op&& op,
+        ssize_t grain = 0) {
+    if constexpr (Rank == 1)
+        return parallel_reduce(
+                pool, ArrayView<const Value, 1>(arr.data(), arr.size()),
+                std::move(init), std::forward<Op>(op), grain);
+    else
+        return parallel_reduce(
+                pool, arr.template view<Rank>(), std::move(init),
+                std::forward<Op>(op), grain);
+}
+
+} // namespace pre
@@ -0,0 +1,286 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A heap-allocated memory arena, safe to allocate from any number of
+/// threads.
+///
+/// Allocation bumps an atomic offset in the current block, so that
+/// in the common case it is a single fetch-and-add. The thread that
+/// overflows the current block installs a new one with compare-and-swap,
+/// taking it from the free blocks if possible. Only this slow path
+/// locks a mutex, to manage the free and full blocks. Large allocations
+/// of more than a quarter of the block size get a dedicated block,
+/// so they do not waste the rest of the current block.
+///
+/// \note
+/// As with `HeapArena`, `clear()` recycles the blocks and `reset()`
+/// deallocates them, but neither is safe to call while other threads
+/// are allocating. The allocator must be safe to call from any thread.
+///
+template <typename Alloc = std::allocator<std::byte>>
+class ConcurrentHeapArena {
+  public:
+    typedef Alloc allocator_type;
+
+    typedef std::allocator_traits<Alloc> allocator_traits;
+
+    ConcurrentHeapArena(size_t block_size = 0, const Alloc& alloc = Alloc())
+        : block_size_(block_size), //
+          free_blocks_(alloc),     //
+          full_blocks_(alloc), alloc_(alloc) {
+        // Round up to 256 byte interval.
+        block_size_ += 255u;
+        block_size_ &= ~size_t(255);
+        if (block_size_ == 0)
+            block_size_ = 65536;
+        // Allocate initial block, reserve blocks.
+        block_.store(block_take_(block_size_), std::memory_order_relaxed);
+        free_blocks_.reserve(4);
+        full_blocks_.reserve(4);
+    }
+
+    ConcurrentHeapArena(const ConcurrentHeapArena&) = delete;
+
+    ConcurrentHeapArena(ConcurrentHeapArena&& other) noexcept
+        : block_size_(steal(other.block_size_)),
+          block_(other.block_.exchange(nullptr, std::memory_order_relaxed)),
+          free_blocks_(std::move(other.free_blocks_)),
+          full_blocks_(std::move(other.full_blocks_)),
+          alloc_(std::move(other.alloc_)) {
+    }
+
+    ~ConcurrentHeapArena() {
+        deallocate_all_();
+    }
+
+    ConcurrentHeapArena& operator=(const ConcurrentHeapArena&) = delete;
+
+    ConcurrentHeapArena& operator=(ConcurrentHeapArena&& other) noexcept {
+        if (this != &other) {
+            deallocate_all_();
+            block_size_ = steal(other.block_size_);
+            block_.store(
+                    other.block_.exchange(nullptr, std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+            free_blocks_ = std::move(other.free_blocks_);
+            full_blocks_ = std::move(other.full_blocks_);
+            if constexpr (allocator_traits::
+                                  propagate_on_container_move_assignment::value)
+                alloc_ = std::move(other.alloc_);
+        }
+        return *this;
+    }
+
+  public:
+    /// Allocate bytes.
+    void* allocate(size_t sz) {
+        // Round up to 16 byte interval.
+        sz += 15u;
+        sz &= ~size_t(15);
+        if (sz == 0)
+            return nullptr;
+
+        if (sz > block_size_ / 4) {
+            // Use dedicated block.
+            Block* block = block_take_(sz);
+            block->offset.store(sz, std::memory_order_relaxed);
+            std::unique_lock<std::mutex> lock(mutex_);
+            full_blocks_.push_back(block);
+            return block->data();
+        }
+        Block* block = block_.load(std::memory_order_acquire);
+        while (true) {
+            size_t offset =
+                    block->offset.fetch_add(sz, std::memory_order_relaxed);
+            if (offset + sz <= block->size)
+                return block->data() + offset;
+            // Another thread already installed the next block?
+            Block* current = block_.load(std::memory_order_acquire);
+            if (current != block) {
+                block = current;
+                continue;
+            }
+            // Install next block.
+            Block* next = block_take_(block_size_);
+            if (block_.compare_exchange_strong(
+                        block, next, std::memory_order_acq_rel,
+                        std::memory_order_acquire)) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                full_blocks_.push_back(block);
+                block = next;
+            }
+            else {
+                // Lost the race, so put the block back.
+                std::unique_lock<std::mutex> lock(mutex_);
+                free_blocks_.push_back(next);
+            }
+        }
+    }
+
+    /// Allocate bytes with given alignment.
+    ///
+    /// \throw std::invalid_argument
+    /// If alignment is not a power of 2.
+    ///
+    void* allocate(size_t sz, size_t align) {
+        if (!std::has_single_bit(align))
+            throw std::invalid_argument(__func__);
+        if (align <= 16 || sz == 0)
+            return allocate(sz);
+        // Bump by the worst case padding, since allocations are always
+        // aligned to 16 bytes.
+        auto pos = std::uintptr_t(allocate(sz + align - 16));
+        return reinterpret_cast<void*>((pos + align - 1) & ~(align - 1));
+    }
+
+    /// Allocate given type, with its alignment.
+    template <typename T>
+    T* allocate(size_t count = 1) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /// Clear.
+    void clear() {
+        // Clear current block.
+        block_.load(std::memory_order_relaxed)
+                ->offset.store(0, std::memory_order_relaxed);
+        // Convert full blocks to free blocks.
+        std::unique_lock<std::mutex> lock(mutex_);
+        free_blocks_.reserve(free_blocks_.size() + full_blocks_.size());
+        for (Block* block : full_blocks_) {
+            block->offset.store(0, std::memory_order_relaxed);
+            free_blocks_.push_back(block);
+        }
+        full_blocks_.clear();
+    }
+
+    /// Clear and deallocate.
+    void reset() {
+        block_.load(std::memory_order_relaxed)
+                ->offset.store(0, std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (Block* block : free_blocks_)
+            block_deallocate_(block);
+        for (Block* block : full_blocks_)
+            block_deallocate_(block);
+        free_blocks_.clear();
+        full_blocks_.clear();
+    }
+
+  private:
+    /// A memory block, with the bytes following the header.
+    struct alignas(16) Block {
+        size_t size;               ///< Size, excluding header.
+        std::atomic_size_t offset; ///< Offset, possibly past size.
+        std::byte* data() noexcept {
+            return reinterpret_cast<std::byte*>(this) + sizeof(Block);
+        }
+    };
+
+    size_t block_size_ = 0;
+
+    /// Current block.
+    std::atomic<Block*> block_ = nullptr;
+
+    /// Mutex for free and full blocks.
+    std::mutex mutex_;
+
+    template <typename T>
+    using RebindAlloc = typename allocator_traits::template rebind_alloc<T>;
+
+    std::vector<Block*, RebindAlloc<Block*>> free_blocks_;
+
+    std::vector<Block*, RebindAlloc<Block*>> full_blocks_;
+
+    RebindAlloc<std::byte> alloc_;
+
+  private:
+    /// Take free block of at least the given size, or allocate one.
+    Block* block_take_(size_t size) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (size_t index = free_blocks_.size(); index-- > 0;) {
+                Block* block = free_blocks_[index];
+                if (block->size >= size) {
+                    free_blocks_.erase(free_blocks_.begin() + index);
+                    return block;
+                }
+            }
+        }
+        std::byte* ptr = alloc_.allocate(sizeof(Block) + size);
+        Block* block = ::new (ptr) Block;
+        block->size = size;
+        block->offset.store(0, std::memory_order_relaxed);
+        return block;
+    }
+
+    void block_deallocate_(Block* block) noexcept {
+        size_t size = block->size;
+        block->~Block();
+        alloc_.deallocate(
+                reinterpret_cast<std::byte*>(block), sizeof(Block) + size);
+    }
+
+    void deallocate_all_() noexcept {
+        if (Block* block = block_.exchange(nullptr, std::memory_order_relaxed))
+            block_deallocate_(block);
+        for (Block* block : free_blocks_)
+            block_deallocate_(block);
+        for (Block* block : full_blocks_)
+            block_deallocate_(block);
+        free_blocks_.clear();
+        full_blocks_.clear();
+    }
+};
+
+} // namespace pre
+
+template <typename Alloc>
+inline void* operator new(size_t sz, pre::ConcurrentHeapArena<Alloc>& arena) {
+    return arena.allocate(sz);
+}
+
+template <typename Alloc>
+inline void* operator new[](size_t sz, pre::ConcurrentHeapArena<Alloc>& arena) {
+    return arena.allocate(sz);
+}
+
+template <typename Alloc>
+inline void* operator new(
+        size_t sz,
+        std::align_val_t align,
+        pre::ConcurrentHeapArena<Alloc>& arena) {
+    return arena.allocate(sz, size_t(align));
+}
+
+template <typename Alloc>
+inline void* operator new[](
+        size_t sz,
+        std::align_val_t align,
+        pre::ConcurrentHeapArena<Alloc>& arena) {
+    return arena.allocate(sz, size_t(align));
+}
+
+template <typename Alloc>
+inline void operator delete(void*, pre::ConcurrentHeapArena<Alloc>&) noexcept {
+    // Do nothing
+}
+
+template <typename Alloc>
+inline void operator delete[](void*, pre::ConcurrentHeapArena<Alloc>&) noexcept {
+    // Do nothing
+}
+
+template <typename Alloc>
+inline void operator delete(
+        void*, std::align_val_t, pre::ConcurrentHeapArena<Alloc>&) noexcept {
+    // Do nothing
+}
+
+template <typename Alloc>
+inline void operator delete[](
+        void*, std::align_val_t, pre::ConcurrentHeapArena<Alloc>&) noexcept {
+    // Do nothing
+}
@@ -0,0 +1,276 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A heap-allocated memory pool, safe to use from any number of threads.
+///
+/// Each thread keeps a magazine (cache) of free elements per pool, and
+/// allocates from and deallocates to its magazine without locking. An
+/// empty magazine is refilled with a batch of elements from a shared
+/// depot, and a full magazine flushes a batch back to the depot, so
+/// the depot lock is only taken once per batch. The depot in turn gets
+/// new elements from a `HeapPool`.
+///
+/// \note
+/// Elements are interchangeable, so it is fine to deallocate an element
+/// on a different thread than the one that allocated it. The element
+/// simply joins the magazine of the deallocating thread. When a thread
+/// exits, its magazines flush back to their depots. When the pool is
+/// destroyed, all memory is released at once, even if the magazines
+/// of other threads still hold elements. Those threads drop their
+/// magazines later without touching the elements.
+///
+/// \note
+/// Unlike `HeapPool`, there is no `clear()`, since there is no way to
+/// reclaim the elements cached by other threads. Also, pointers are not
+/// checked for garbage.
+///
+template <typename Alloc = std::allocator<std::byte>>
+class ConcurrentHeapPool {
+  public:
+    typedef Alloc allocator_type;
+
+    /// Elements exchanged with the depot at once.
+    static constexpr size_t BatchCount = 64;
+
+    /// Maximum elements per magazine.
+    static constexpr size_t MaxCount = 2 * BatchCount;
+
+    /// Constructor.
+    ///
+    /// \param[in] elem_size
+    /// Element size in bytes.
+    ///
+    /// \param[in] pool_size
+    /// Elements per pool. See `HeapPool`.
+    ///
+    /// \param[in] alloc
+    /// Allocator.
+    ///
+    ConcurrentHeapPool(
+            size_t elem_size,
+            size_t pool_size = 0,
+            const Alloc& alloc = Alloc())
+        : depot_(std::make_shared<Depot>(elem_size, pool_size, alloc)) {
+    }
+
+    ConcurrentHeapPool(const ConcurrentHeapPool&) = delete;
+
+    ConcurrentHeapPool(ConcurrentHeapPool&& other) noexcept
+        : depot_(std::move(other.depot_)) {
+    }
+
+    ~ConcurrentHeapPool() {
+        close_();
+    }
+
+    ConcurrentHeapPool& operator=(const ConcurrentHeapPool&) = delete;
+
+    ConcurrentHeapPool& operator=(ConcurrentHeapPool&& other) noexcept {
+        if (this != &other) {
+            close_();
+            depot_ = std::move(other.depot_);
+        }
+        return *this;
+    }
+
+  public:
+    /// Element size in bytes.
+    size_t elem_size() const noexcept {
+        return depot_->pool.elem_size();
+    }
+
+    /// Allocate element.
+    [[nodiscard]] void* allocate() {
+        Magazine* magazine = registry_().find(depot_);
+        if (magazine == nullptr) {
+            // Thread is exiting, go straight to the depot.
+            Magazine temp{depot_};
+            depot_->take(temp, 1);
+            return temp.pop();
+        }
+        if (magazine->count == 0)
+            depot_->take(*magazine, BatchCount);
+        return magazine->pop();
+    }
+
+    /// Deallocate element, possibly allocated on another thread.
+    void deallocate(void* ptr) {
+        if (ptr == nullptr)
+            return;
+        Magazine* magazine = registry_().find(depot_);
+        if (magazine == nullptr) {
+            // Thread is exiting, go straight to the depot.
+            Magazine temp{depot_};
+            temp.push(ptr);
+            depot_->put(temp, 1);
+            return;
+        }
+        if (magazine->count >= MaxCount)
+            depot_->put(*magazine, BatchCount);
+        magazine->push(ptr);
+    }
+
+    /// Flush the magazine of the calling thread back to the depot.
+    void flush() {
+        if (Magazine* magazine = registry_().find(depot_))
+            depot_->put(*magazine, magazine->count);
+    }
+
+  private:
+    struct Depot;
+
+    /// A magazine of free elements, as an intrusive list.
+    struct Magazine {
+        std::shared_ptr<Depot> depot;
+
+        std::byte* head = nullptr;
+
+        size_t count = 0;
+
+        void push(void* ptr) noexcept {
+            std::memcpy(ptr, &head, sizeof(void*));
+            head = static_cast<std::byte*>(ptr);
+            count++;
+        }
+
+        std::byte* pop() noexcept {
+            std::byte* ptr = head;
+            std::memcpy(&head, ptr, sizeof(void*));
+            count--;
+            return ptr;
+        }
+    };
+
+    /// A depot shared by all threads.
+    struct Depot {
+        Depot(size_t elem_size, size_t pool_size, const Alloc& alloc)
+            : pool(elem_size, pool_size, alloc) {
+        }
+
+        std::mutex mutex;
+
+        HeapPool<Alloc> pool;
+
+        Magazine free = {};
+
+        /// Closed, i.e., the pool is destroyed?
+        std::atomic_bool closed = false;
+
+        /// Take up to given count into magazine, allocating from the pool
+        /// as needed.
+        void take(Magazine& magazine, size_t count) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (free.count > 0 && count > 0) {
+                magazine.push(free.pop());
+                count--;
+            }
+            while (count-- > 0)
+                magazine.push(pool.allocate());
+        }
+
+        /// Put up to given count from magazine, or drop everything if
+        /// closed.
+        void put(Magazine& magazine, size_t count) noexcept {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (closed.load(std::memory_order_relaxed)) {
+                magazine.head = nullptr;
+                magazine.count = 0;
+                return;
+            }
+            while (magazine.count > 0 && count-- > 0)
+                free.push(magazine.pop());
+        }
+    };
+
+    /// The magazines of one thread, one per pool.
+    struct Registry {
+        ~Registry() {
+            for (Magazine& magazine : magazines)
+                magazine.depot->put(magazine, magazine.count);
+            magazines.clear();
+            // Elements freed after this point go straight to the depot.
+            is_alive = false;
+        }
+
+        /// Find or add magazine of the given depot, or return null if
+        /// the thread is exiting.
+        Magazine* find(const std::shared_ptr<Depot>& depot) {
+            if (!is_alive)
+                return nullptr;
+            if (last < magazines.size() && magazines[last].depot == depot)
+                return &magazines[last];
+            for (last = 0; last < magazines.size(); last++)
+                if (magazines[last].depot == depot)
+                    return &magazines[last];
+            // Drop magazines of destroyed pools.
+            std::erase_if(magazines, [](const Magazine& magazine) {
+                return magazine.depot->closed.load(std::memory_order_relaxed);
+            });
+            magazines.push_back(Magazine{depot});
+            last = magazines.size() - 1;
+            return &magazines[last];
+        }
+
+        std::vector<Magazine> magazines;
+
+        size_t last = 0;
+
+        bool is_alive = true;
+    };
+
+    static Registry& registry_() noexcept {
+        static thread_local Registry registry;
+        return registry;
+    }
+
+    void close_() noexcept {
+        if (depot_) {
+            std::unique_lock<std::mutex> lock(depot_->mutex);
+            depot_->closed.store(true, std::memory_order_relaxed);
+            depot_->free = {};
+            depot_->pool.reset();
+        }
+    }
+
+  private:
+    /// Depot, shared with the magazines of all threads.
+    std::shared_ptr<Depot> depot_;
+};
+
+/// A heap-allocated pool for a given object, safe to use from any
+/// number of threads.
+template <typename Obj, typename Alloc = std::allocator<std::byte>>
+class ConcurrentObjectHeapPool final : public ConcurrentHeapPool<Alloc> {
+  public:
+    using Base = ConcurrentHeapPool<Alloc>;
+
+    ConcurrentObjectHeapPool(size_t pool_size = 0, const Alloc& alloc = Alloc())
+        : Base(sizeof(Obj), pool_size, alloc) {
+    }
+
+    ConcurrentObjectHeapPool(ConcurrentObjectHeapPool&& other) noexcept
+        : Base(static_cast<Base&&>(other)) {
+    }
+
+    ~ConcurrentObjectHeapPool() = default;
+
+    Obj* allocate() {
+        return static_cast<Obj*>(static_cast<Base&>(*this).allocate());
+    }
+
+    template <typename... Args>
+    Obj* create(Args&&... args) {
+        return new (allocate()) Obj(std::forward<Args>(args)...);
+    }
+
+    void destroy(Obj* object) {
+        if (object) {
+            object->~Obj();
+            static_cast<Base&>(*this).deallocate(object);
+        }
+    }
+};
+
+} // namespace pre
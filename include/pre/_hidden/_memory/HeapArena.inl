@@ -4,7 +4,16 @@
 namespace pre {
 
 /// A heap-allocated memory arena.
-template <typename Alloc = std::allocator<std::byte>>
+///
+/// \tparam Alloc
+/// Block allocator.
+///
+/// \tparam Stats
+/// Stats policy, either `NoMemoryStats` or `MemoryStats`.
+///
+template <
+        typename Alloc = std::allocator<std::byte>,
+        typename Stats = NoMemoryStats>
 class HeapArena {
   public:
     typedef Alloc allocator_type;
@@ -17,13 +26,14 @@ class HeapArena {
           full_blocks_(alloc), alloc_(alloc) {
         // Round up to 256 byte interval.
         block_size_ += 255u;
-        block_size_ &= ~255u;
+        block_size_ &= ~size_t(255);
         if (block_size_ == 0)
             block_size_ = 65536;
         // Allocate initial block, reserve blocks.
         block_.size = block_size_;
         block_.begin = alloc_.allocate(block_.size);
         block_.offset = 0;
+        stats_.block_allocate(block_.size);
         free_blocks_.reserve(4);
         full_blocks_.reserve(4);
     }
@@ -35,17 +45,21 @@ class HeapArena {
           block_(steal(other.block_)),
           free_blocks_(std::move(other.free_blocks_)),
           full_blocks_(std::move(other.full_blocks_)),
-          alloc_(std::move(other.alloc_)) {
+          alloc_(std::move(other.alloc_)),
+          stats_(steal(other.stats_)),
+          generation_(steal(other.generation_)) {
     }
 
     HeapArena(HeapArena&& other, const Alloc& alloc) : alloc_(alloc) {
         // We need to be able to deallocate the pointers we steal!
-        if (alloc_ != other.alloc)
+        if (alloc_ != other.alloc_)
             throw std::invalid_argument(__func__);
         block_size_ = steal(other.block_size_);
         block_ = steal(other.block_);
         free_blocks_ = std::move(other.free_blocks_);
         full_blocks_ = std::move(other.full_blocks_);
+        stats_ = steal(other.stats_);
+        generation_ = steal(other.generation_);
     }
 
     ~HeapArena() {
@@ -63,6 +77,8 @@ class HeapArena {
         block_ = steal(other.block_);
         free_blocks_ = std::move(other.free_blocks_);
         full_blocks_ = std::move(other.full_blocks_);
+        stats_ = steal(other.stats_);
+        generation_ = steal(other.generation_);
         if constexpr (allocator_traits::
                               propagate_on_container_move_assignment::value)
             alloc_ = std::move(other.alloc_);
@@ -70,37 +86,110 @@ class HeapArena {
     }
 
   public:
-    /// Allocate bytes.
+    /// Allocate bytes, aligned to 16 bytes.
     void* allocate(size_t sz) {
+        return allocate(sz, 16);
+    }
+
+    /// Allocate bytes with given alignment.
+    ///
+    /// \param[in] sz
+    /// Size in bytes, rounded up to a multiple of 16.
+    ///
+    /// \param[in] align
+    /// Alignment in bytes, at least 16.
+    ///
+    /// \throw std::invalid_argument
+    /// If alignment is not a power of 2.
+    ///
+    void* allocate(size_t sz, size_t align) {
+        if (!std::has_single_bit(align))
+            throw std::invalid_argument(__func__);
+        if (align < 16)
+            align = 16;
         // Round up to 16 byte interval.
         sz += 15u;
-        sz &= ~15u;
+        sz &= ~size_t(15);
         if (sz == 0)
             return nullptr;
 
-        if (block_.size < block_.offset + sz) {
+        void* pos = block_.begin + block_.offset;
+        size_t space = block_.size - block_.offset;
+        if (!std::align(align, sz, pos, space)) {
+            // Worst case padding, in case the block is not aligned.
+            size_t least_sz = sz + align - 1;
             full_blocks_.emplace_back(block_);
-            if (free_blocks_.size() == 0 || free_blocks_.back().size < sz) {
+            if (free_blocks_.size() == 0 ||
+                free_blocks_.back().size < least_sz) {
                 // Allocate block.
-                block_.size = std::max(block_size_, sz);
+                block_.size = std::max(block_size_, least_sz);
                 block_.begin = alloc_.allocate(block_.size);
                 block_.offset = 0;
+                stats_.block_allocate(block_.size);
             }
             else {
                 // Use free block.
                 block_ = free_blocks_.back();
                 free_blocks_.pop_back();
             }
+            pos = block_.begin;
+            space = block_.size;
+            std::align(align, sz, pos, space);
         }
-        std::byte* pos = block_.begin + block_.offset;
-        block_.offset += sz;
-        return static_cast<void*>(pos);
+        size_t offset = block_.size - space + sz;
+        stats_.allocate(offset - block_.offset);
+        block_.offset = offset;
+        return pos;
     }
 
-    /// Allocate given type.
+    /// Allocate given type, with its alignment.
     template <typename T>
     T* allocate(size_t count = 1) {
-        return static_cast<T*>(allocate(sizeof(T) * count));
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /// A marker, to rewind to.
+    struct Marker {
+        size_t generation = 0;      ///< Generation, see `clear()`.
+        size_t full_count = 0;      ///< Full block count.
+        std::byte* begin = nullptr; ///< Pointer to current block bytes.
+        size_t offset = 0;          ///< Offset in current block.
+    };
+
+    /// Mark current state.
+    Marker mark() const noexcept {
+        return {generation_, full_blocks_.size(), block_.begin, block_.offset};
+    }
+
+    /// Rewind to marked state, releasing everything allocated since.
+    ///
+    /// \note
+    /// Blocks filled since the mark become free blocks, to be reused
+    /// by later allocations, as in `clear()`. Rewinding to nested marks
+    /// must happen in reverse order.
+    ///
+    /// \throw std::logic_error
+    /// If the marker is stale. Markers from before the arena was last
+    /// cleared or reset are always detected. Markers rewound past are
+    /// detected only on a best-effort basis, if the arena has not since
+    /// reallocated past the marked position, so this is no substitute
+    /// for rewinding in reverse order.
+    ///
+    void rewind(const Marker& marker) {
+        if (!try_rewind_(marker))
+            throw std::logic_error(__func__);
+    }
+
+    /// Create scoped marker object to automatically rewind on destruction.
+    ///
+    /// \note
+    /// If the marker is stale by the end of the scope, e.g., because the
+    /// arena was cleared in the scope, this does nothing rather than
+    /// throwing from the destructor.
+    ///
+    auto scoped_mark() {
+        return Scoped(
+                []() {}, [this, marker = mark()]() { try_rewind_(marker); });
     }
 
     /// Clear.
@@ -114,17 +203,32 @@ class HeapArena {
             free_blocks_.back().offset = 0;
         }
         full_blocks_.clear();
+        stats_.set_bytes(0);
+        generation_++; // Invalidate markers.
     }
 
     /// Clear and deallocate.
     void reset() {
         block_.offset = 0;
         for (Block& block : free_blocks_)
-            alloc_.deallocate(block.begin, block.size);
+            block_deallocate_(block);
         for (Block& block : full_blocks_)
-            alloc_.deallocate(block.begin, block.size);
+            block_deallocate_(block);
         free_blocks_.clear();
         full_blocks_.clear();
+        stats_.set_bytes(0);
+        generation_++; // Invalidate markers.
+    }
+
+    /// Stats snapshot.
+    const MemoryStatsSnapshot& stats() const noexcept
+        requires(Stats::is_enabled) {
+        return stats_.snapshot();
+    }
+
+    /// Reset peak bytes to bytes in use.
+    void reset_peak() noexcept requires(Stats::is_enabled) {
+        stats_.reset_peak();
     }
 
     void swap(HeapArena& other) {
@@ -133,6 +237,8 @@ class HeapArena {
             std::swap(block_, other.block_);
             std::swap(free_blocks_, other.free_blocks_);
             std::swap(full_blocks_, other.full_blocks_);
+            std::swap(stats_, other.stats_);
+            std::swap(generation_, other.generation_);
             if constexpr (allocator_traits::propagate_on_container_swap::value)
                 std::swap(alloc_, other.alloc_);
         }
@@ -158,26 +264,110 @@ class HeapArena {
     std::vector<Block, RebindAlloc<Block>> full_blocks_;
 
     RebindAlloc<std::byte> alloc_;
+
+    [[no_unique_address]] Stats stats_;
+
+    /// Generation, incremented by `clear()` and `reset()` to detect
+    /// stale markers.
+    size_t generation_ = 0;
+
+  private:
+    /// Rewind to marked state if the marker is not stale, see `rewind()`.
+    ///
+    /// \returns
+    /// Returns false if the marker is stale, in which case this does
+    /// nothing.
+    ///
+    bool try_rewind_(const Marker& marker) {
+        if (marker.generation != generation_ ||
+            marker.full_count > full_blocks_.size())
+            return false;
+        if (marker.full_count == full_blocks_.size()) {
+            if (marker.begin != block_.begin || marker.offset > block_.offset)
+                return false;
+            block_.offset = marker.offset;
+            stats_.set_bytes(bytes_());
+            return true;
+        }
+        if (marker.begin != full_blocks_[marker.full_count].begin)
+            return false;
+        // Convert current block and blocks filled since to free blocks,
+        // most recent first, so the least recent is reused first.
+        free_blocks_.reserve(
+                free_blocks_.size() + full_blocks_.size() - marker.full_count);
+        free_blocks_.push_back(block_);
+        free_blocks_.back().offset = 0;
+        while (full_blocks_.size() > marker.full_count + 1) {
+            free_blocks_.push_back(full_blocks_.back());
+            free_blocks_.back().offset = 0;
+            full_blocks_.pop_back();
+        }
+        block_ = full_blocks_.back();
+        block_.offset = marker.offset;
+        full_blocks_.pop_back();
+        stats_.set_bytes(bytes_());
+        return true;
+    }
+
+    void block_deallocate_(Block& block) noexcept {
+        alloc_.deallocate(block.begin, block.size);
+        stats_.block_deallocate(block.size);
+    }
+
+    /// Bytes in use, only computed if tracked.
+    size_t bytes_() const noexcept {
+        size_t bytes = 0;
+        if constexpr (Stats::is_enabled) {
+            bytes = block_.offset;
+            for (const Block& block : full_blocks_)
+                bytes += block.offset;
+        }
+        return bytes;
+    }
 };
 
 } // namespace pre
 
-template <typename Alloc>
-inline void* operator new(size_t sz, pre::HeapArena<Alloc>& arena) {
+template <typename Alloc, typename Stats>
+inline void* operator new(size_t sz, pre::HeapArena<Alloc, Stats>& arena) {
     return arena.allocate(sz);
 }
 
-template <typename Alloc>
-inline void* operator new[](size_t sz, pre::HeapArena<Alloc>& arena) {
+template <typename Alloc, typename Stats>
+inline void* operator new[](size_t sz, pre::HeapArena<Alloc, Stats>& arena) {
     return arena.allocate(sz);
 }
 
-template <typename Alloc>
-inline void operator delete(void*, pre::HeapArena<Alloc>&) noexcept {
+template <typename Alloc, typename Stats>
+inline void* operator new(
+        size_t sz, std::align_val_t align, pre::HeapArena<Alloc, Stats>& arena) {
+    return arena.allocate(sz, size_t(align));
+}
+
+template <typename Alloc, typename Stats>
+inline void* operator new[](
+        size_t sz, std::align_val_t align, pre::HeapArena<Alloc, Stats>& arena) {
+    return arena.allocate(sz, size_t(align));
+}
+
+template <typename Alloc, typename Stats>
+inline void operator delete(void*, pre::HeapArena<Alloc, Stats>&) noexcept {
+    // Do nothing
+}
+
+template <typename Alloc, typename Stats>
+inline void operator delete[](void*, pre::HeapArena<Alloc, Stats>&) noexcept {
+    // Do nothing
+}
+
+template <typename Alloc, typename Stats>
+inline void operator delete(
+        void*, std::align_val_t, pre::HeapArena<Alloc, Stats>&) noexcept {
     // Do nothing
 }
 
-template <typename Alloc>
-inline void operator delete[](void*, pre::HeapArena<Alloc>&) noexcept {
+template <typename Alloc, typename Stats>
+inline void operator delete[](
+        void*, std::align_val_t, pre::HeapArena<Alloc, Stats>&) noexcept {
     // Do nothing
 }
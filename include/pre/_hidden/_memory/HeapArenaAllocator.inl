@@ -4,7 +4,14 @@
 namespace pre {
 
 /// A standard-compatible memory arena allocator.
-template <typename T, typename Alloc = std::allocator<std::byte>>
+///
+/// \tparam Stats
+/// Stats policy of the arena, either `NoMemoryStats` or `MemoryStats`.
+///
+template <
+        typename T,
+        typename Alloc = std::allocator<std::byte>,
+        typename Stats = NoMemoryStats>
 class HeapArenaAllocator {
   public:
     typedef T value_type;
@@ -19,21 +26,21 @@ class HeapArenaAllocator {
 
   public:
     HeapArenaAllocator(size_t block_size = 0, const Alloc& alloc = Alloc())
-        : arena_(new HeapArena<Alloc>(block_size, alloc)) {
+        : arena_(new HeapArena<Alloc, Stats>(block_size, alloc)) {
     }
 
     template <typename U>
-    HeapArenaAllocator(const HeapArenaAllocator<U, Alloc>& other)
+    HeapArenaAllocator(const HeapArenaAllocator<U, Alloc, Stats>& other)
         : arena_(other.arena_) {
     }
 
     template <typename U>
-    HeapArenaAllocator(HeapArenaAllocator<U, Alloc>&& other)
+    HeapArenaAllocator(HeapArenaAllocator<U, Alloc, Stats>&& other)
         : arena_(std::move(other.arena_)) {
     }
 
     template <typename U>
-    HeapArenaAllocator& operator=(const HeapArenaAllocator<U, Alloc>& other) {
+    HeapArenaAllocator& operator=(const HeapArenaAllocator<U, Alloc, Stats>& other) {
         if (this != &other) {
             this->arena_ = other.arena_;
         }
@@ -41,7 +48,7 @@ class HeapArenaAllocator {
     }
 
     template <typename U>
-    HeapArenaAllocator& operator=(HeapArenaAllocator<U, Alloc>&& other) {
+    HeapArenaAllocator& operator=(HeapArenaAllocator<U, Alloc, Stats>&& other) {
         this->arena_ = std::move(other.arena_);
         return *this;
     }
@@ -54,27 +61,33 @@ class HeapArenaAllocator {
         arena_->reset();
     }
 
+    /// Stats snapshot of the arena.
+    const MemoryStatsSnapshot& stats() const noexcept
+        requires(Stats::is_enabled) {
+        return arena_->stats();
+    }
+
     [[nodiscard]] T* allocate(size_t n) {
-        return static_cast<T*>(arena_->allocate(sizeof(T) * n));
+        return static_cast<T*>(arena_->allocate(sizeof(T) * n, alignof(T)));
     }
 
     void deallocate(T*, size_t) {
     }
 
     template <typename U>
-    bool operator==(const HeapArenaAllocator<U, Alloc>& other) const {
+    bool operator==(const HeapArenaAllocator<U, Alloc, Stats>& other) const {
         return arena_.get() == other.arena_.get();
     }
 
     template <typename U>
-    bool operator!=(const HeapArenaAllocator<U, Alloc>& other) const {
+    bool operator!=(const HeapArenaAllocator<U, Alloc, Stats>& other) const {
         return arena_.get() != other.arena_.get();
     }
 
   private:
-    std::shared_ptr<HeapArena<Alloc>> arena_;
+    std::shared_ptr<HeapArena<Alloc, Stats>> arena_;
 
-    template <typename, typename>
+    template <typename, typename, typename>
     friend class HeapArenaAllocator;
 };
 
@@ -4,13 +4,38 @@
 namespace pre {
 
 /// A heap-allocated memory pool.
-template <typename Alloc = std::allocator<std::byte>>
+///
+/// \note
+/// Each pool is a slab whose size is a power of 2, allocated at an
+/// address aligned to its size, with a header at the beginning. So
+/// the pool owning an element is found by masking the low bits of its
+/// address, and deallocation is constant time. Pools with at least one
+/// free element are kept in an intrusive doubly-linked list, so that
+/// allocation is also constant time. Elements are handed out from
+/// the free list of the pool first, then from the never-used tail of
+/// the pool, so that new pools and clearing need not touch the elements.
+///
+/// \tparam Alloc
+/// Slab allocator.
+///
+/// \tparam Stats
+/// Stats policy, either `NoMemoryStats` or `MemoryStats`.
+///
+template <
+        typename Alloc = std::allocator<std::byte>,
+        typename Stats = NoMemoryStats>
 class HeapPool {
   public:
     typedef Alloc allocator_type;
 
     typedef std::allocator_traits<Alloc> allocator_traits;
 
+    /// Minimum slab size, as a power of 2.
+    static constexpr size_t MinSlabLog2 = 12;
+
+    /// Maximum slab size, as a power of 2.
+    static constexpr size_t MaxSlabLog2 = 24;
+
     /// Constructor.
     ///
     /// \param[in] elem_size
@@ -19,41 +44,61 @@ class HeapPool {
     /// \param[in] pool_size
     /// Elements per pool. If left at default value of 0, this
     /// is chosen so that the size of each pool is approximately 64KB.
+    /// Otherwise, this is rounded up to fill the slab.
     ///
     /// \param[in] alloc
     /// Allocator.
     ///
+    /// \throw std::length_error
+    /// If the pool would be larger than the maximum slab size.
+    ///
     HeapPool(
             size_t elem_size,
             size_t pool_size = 0,
-            const Alloc& alloc = Alloc()) noexcept
+            const Alloc& alloc = Alloc())
         : elem_size_(elem_size), //
           pool_size_(pool_size), //
           alloc_(alloc) {
         if (elem_size_ < sizeof(void*))
             elem_size_ = sizeof(void*);
-        if (pool_size_ == 0) {
-            pool_size_ = 65536 / elem_size;
-            if (pool_size_ == 0)
-                pool_size_ = 1;
-        }
+        if (pool_size_ == 0)
+            pool_size_ = std::max<size_t>(
+                    (65536 - sizeof(Pool)) / elem_size_, 1);
+        if (elem_size_ > ((size_t(1) << MaxSlabLog2) - sizeof(Pool)) /
+                                 pool_size_)
+            throw std::length_error(__func__);
+        slab_log2_ = std::max<size_t>(
+                std::bit_width(sizeof(Pool) + elem_size_ * pool_size_ - 1),
+                MinSlabLog2);
+        pool_size_ = ((size_t(1) << slab_log2_) - sizeof(Pool)) / elem_size_;
     }
 
     HeapPool(const HeapPool&) = delete;
 
     HeapPool(HeapPool&& other) noexcept
         : elem_size_(steal(other.elem_size_)),
-          pool_size_(steal(other.pool_size_)), //
-          first_(steal(other.first_)), alloc_(std::move(other.alloc_)) {
+          pool_size_(steal(other.pool_size_)),
+          slab_log2_(steal(other.slab_log2_)), //
+          first_(steal(other.first_)),
+          first_avail_(steal(other.first_avail_)),
+          count_(steal(other.count_)),
+          pool_count_(steal(other.pool_count_)),
+          alloc_(std::move(other.alloc_)),
+          stats_(steal(other.stats_)) {
     }
 
     HeapPool(HeapPool&& other, const Alloc& alloc) : alloc_(alloc) {
         // We need to be able to deallocate the pointers we steal!
-        if (alloc_ == other.alloc)
+        if (alloc_ != other.alloc_)
             throw std::invalid_argument(__func__);
         elem_size_ = steal(other.elem_size_);
         pool_size_ = steal(other.pool_size_);
+        slab_log2_ = steal(other.slab_log2_);
         first_ = steal(other.first_);
+        first_avail_ = steal(other.first_avail_);
+        count_ = steal(other.count_);
+        pool_count_ = steal(other.pool_count_);
+        stats_ = steal(other.stats_);
     }
 
     ~HeapPool() {
@@ -63,61 +108,102 @@ class HeapPool {
     HeapPool& operator=(const HeapPool&) = delete;
 
     HeapPool& operator=(HeapPool&& other) noexcept {
-        elem_size_ = steal(other.elem_size_);
-        pool_size_ = steal(other.pool_size_);
-        first_ = steal(other.first_);
-        if constexpr (allocator_traits::
-                              propagate_on_container_move_assignment::value)
-            alloc_ = std::move(other.alloc_);
+        if (this != &other) {
+            reset();
+            elem_size_ = steal(other.elem_size_);
+            pool_size_ = steal(other.pool_size_);
+            slab_log2_ = steal(other.slab_log2_);
+            first_ = steal(other.first_);
+            first_avail_ = steal(other.first_avail_);
+            count_ = steal(other.count_);
+            pool_count_ = steal(other.pool_count_);
+            stats_ = steal(other.stats_);
+            if constexpr (allocator_traits::
+                                  propagate_on_container_move_assignment::value)
+                alloc_ = std::move(other.alloc_);
+        }
         return *this;
     }
 
   public:
+    /// Element size in bytes.
+    size_t elem_size() const noexcept {
+        return elem_size_;
+    }
+
+    /// Elements per pool.
+    size_t pool_size() const noexcept {
+        return pool_size_;
+    }
+
+    /// Number of pools.
+    size_t pool_count() const noexcept {
+        return pool_count_;
+    }
+
+    /// Number of elements allocated.
+    size_t count() const noexcept {
+        return count_;
+    }
+
+    /// Number of elements in all pools, allocated or not.
+    size_t capacity() const noexcept {
+        return pool_count_ * pool_size_;
+    }
+
+    /// Allocate element in constant time.
     [[nodiscard]] void* allocate() {
-        Pool* pool = first_;
-        while (pool && pool->first_free == nullptr)
-            pool = pool->next;
+        Pool* pool = first_avail_;
         if (pool == nullptr)
             pool = pool_allocate_();
         std::byte* elem = pool->first_free;
-        std::memcpy(&pool->first_free, pool->first_free, sizeof(void*));
-        pool->count++;
+        if (elem)
+            std::memcpy(&pool->first_free, elem, sizeof(void*));
+        else {
+            elem = pool->first_unused;
+            pool->first_unused += elem_size_;
+        }
+        if (++pool->count == pool_size_)
+            avail_unlink_(pool);
+        count_++;
+        stats_.allocate(elem_size_);
         return elem;
     }
 
+    /// Deallocate element in constant time.
+    ///
+    /// \throw std::logic_error
+    /// If the pointer is not at an allocated element boundary of its
+    /// pool. Note that pointers not allocated by any pool of this
+    /// object cannot be detected in general.
+    ///
     void deallocate(void* ptr) {
         if (ptr == nullptr)
             return;
         std::byte* elem = static_cast<std::byte*>(ptr);
-        Pool* pool = first_;
-        while (pool) {
-            // Element in range of pool?
-            std::ptrdiff_t pool_size = elem_size_ * pool_size_;
-            std::ptrdiff_t elem_diff = elem - pool->begin;
-            if (elem_diff >= 0 && elem_diff < pool_size) {
-                // Element in range of pool, but pointer is not
-                // aligned to element boundary?
-                if (elem_diff % std::ptrdiff_t(elem_size_) != 0)
-                    throw std::logic_error(__func__); // Garbage pointer!
-                break;
-            }
-            else {
-                pool = pool->next;
-            }
-        }
-        // Element not in range of any pool?
-        if (!pool)
+        Pool* pool = pool_of_(elem);
+        std::ptrdiff_t elem_diff = elem - pool_begin_(pool);
+        if (elem_diff < 0 || elem >= pool->first_unused ||
+            elem_diff % std::ptrdiff_t(elem_size_) != 0)
             throw std::logic_error(__func__); // Garbage pointer!
         // Prepend.
         std::memcpy(elem, &pool->first_free, sizeof(void*));
         pool->first_free = elem;
-        pool->count--;
+        if (pool->count-- == pool_size_)
+            avail_link_(pool);
+        count_--;
+        stats_.deallocate(elem_size_);
     }
 
     /// Clear.
     void clear() noexcept {
-        for (Pool* pool = first_; pool; pool = pool->next)
+        first_avail_ = nullptr;
+        count_ = 0;
+        stats_.set_bytes(0);
+        for (Pool* pool = first_; pool; pool = pool->next) {
             pool_clear_(pool);
+            avail_link_(pool);
+        }
     }
 
     /// Clear and deallocate.
@@ -128,94 +214,167 @@ class HeapPool {
             pool = next;
         }
         first_ = nullptr;
+        first_avail_ = nullptr;
+        count_ = 0;
+        pool_count_ = 0;
+        stats_.set_bytes(0);
+    }
+
+    /// Stats snapshot.
+    const MemoryStatsSnapshot& stats() const noexcept
+        requires(Stats::is_enabled) {
+        return stats_.snapshot();
+    }
+
+    /// Reset peak bytes to bytes in use.
+    void reset_peak() noexcept requires(Stats::is_enabled) {
+        stats_.reset_peak();
     }
 
     void swap(HeapPool& other) noexcept {
         if (this != &other) {
             std::swap(elem_size_, other.elem_size_);
             std::swap(pool_size_, other.pool_size_);
+            std::swap(slab_log2_, other.slab_log2_);
             std::swap(first_, other.first_);
+            std::swap(first_avail_, other.first_avail_);
+            std::swap(count_, other.count_);
+            std::swap(pool_count_, other.pool_count_);
+            std::swap(stats_, other.stats_);
             if constexpr (allocator_traits::propagate_on_container_swap::value)
                 std::swap(alloc_, other.alloc_);
         }
     }
 
   private:
-    /// Pool type.
+    /// Pool type, at the beginning of its slab.
     struct alignas(16) Pool {
-        Pool* next;            ///< Pointer to next pool.
-        std::byte* begin;      ///< Pointer to elements.
-        std::byte* first_free; ///< Pointer to first free element.
-        size_t count;          ///< Element allocation count.
+        Pool* next;              ///< Pointer to next pool.
+        Pool* prev_avail;        ///< Pointer to previous available pool.
+        Pool* next_avail;        ///< Pointer to next available pool.
+        std::byte* first_free;   ///< Pointer to first free element.
+        std::byte* first_unused; ///< Pointer to first never-used element.
+        size_t count;            ///< Element allocation count.
+    };
+
+    /// Slab type, for allocating slabs aligned to their size.
+    template <size_t Size>
+    struct alignas(Size) Slab {
+        std::byte bytes[Size];
     };
 
     size_t elem_size_ = 0; ///< Element size in bytes.
     size_t pool_size_ = 0; ///< Pool size in elements.
+    size_t slab_log2_ = 0; ///< Slab size in bytes, as a power of 2.
 
-    /// First pool in list.
+    /// First pool in list of all pools.
     Pool* first_ = nullptr;
 
+    /// First pool in list of pools with at least one free element.
+    Pool* first_avail_ = nullptr;
+
+    size_t count_ = 0;      ///< Element allocation count.
+    size_t pool_count_ = 0; ///< Pool count.
+
     /// Allocator.
     typename allocator_traits::template rebind_alloc<std::byte> alloc_;
 
+    [[no_unique_address]] Stats stats_;
+
   private:
+    static std::byte* pool_begin_(Pool* pool) noexcept {
+        return reinterpret_cast<std::byte*>(pool) + sizeof(Pool);
+    }
+
+    Pool* pool_of_(std::byte* elem) const noexcept {
+        return reinterpret_cast<Pool*>(
+                std::uintptr_t(elem) & ~((std::uintptr_t(1) << slab_log2_) - 1));
+    }
+
+    void avail_link_(Pool* pool) noexcept {
+        pool->prev_avail = nullptr;
+        pool->next_avail = first_avail_;
+        if (first_avail_)
+            first_avail_->prev_avail = pool;
+        first_avail_ = pool;
+    }
+
+    void avail_unlink_(Pool* pool) noexcept {
+        if (pool->prev_avail)
+            pool->prev_avail->next_avail = pool->next_avail;
+        else
+            first_avail_ = pool->next_avail;
+        if (pool->next_avail)
+            pool->next_avail->prev_avail = pool->prev_avail;
+    }
+
+    template <size_t Log2 = MinSlabLog2>
+    std::byte* slab_allocate_() {
+        if constexpr (Log2 < MaxSlabLog2)
+            if (slab_log2_ != Log2)
+                return slab_allocate_<Log2 + 1>();
+        using SlabAlloc = typename allocator_traits::template rebind_alloc<
+                Slab<size_t(1) << Log2>>;
+        SlabAlloc alloc(alloc_);
+        return reinterpret_cast<std::byte*>(
+                std::allocator_traits<SlabAlloc>::allocate(alloc, 1));
+    }
+
+    template <size_t Log2 = MinSlabLog2>
+    void slab_deallocate_(std::byte* ptr) noexcept {
+        if constexpr (Log2 < MaxSlabLog2)
+            if (slab_log2_ != Log2)
+                return slab_deallocate_<Log2 + 1>(ptr);
+        using SlabAlloc = typename allocator_traits::template rebind_alloc<
+                Slab<size_t(1) << Log2>>;
+        SlabAlloc alloc(alloc_);
+        std::allocator_traits<SlabAlloc>::deallocate(
+                alloc, reinterpret_cast<Slab<size_t(1) << Log2>*>(ptr), 1);
+    }
+
     Pool* pool_allocate_() {
-        auto* ptr = alloc_.allocate(sizeof(Pool) + elem_size_ * pool_size_);
-        Pool* pool = reinterpret_cast<Pool*>(ptr);
-        pool->next = nullptr;
-        pool->begin = ptr + sizeof(Pool);
-        pool->count = 0;
+        Pool* pool = reinterpret_cast<Pool*>(slab_allocate_());
+        stats_.block_allocate(size_t(1) << slab_log2_);
         pool_clear_(pool);
-        // Append.
-        if (first_ == nullptr) {
-            first_ = pool; // Set first.
-        }
-        else {
-            Pool* last = first_;
-            while (last->next)
-                last = last->next;
-            last->next = pool;
-        }
+        // Prepend.
+        pool->next = first_;
+        first_ = pool;
+        pool_count_++;
+        avail_link_(pool);
         return pool;
     }
 
-    void pool_deallocate_(Pool* pool) {
-        alloc_.deallocate(
-                reinterpret_cast<std::byte*>(pool),
-                sizeof(Pool) + elem_size_ * pool_size_);
+    void pool_deallocate_(Pool* pool) noexcept {
+        slab_deallocate_(reinterpret_cast<std::byte*>(pool));
+        stats_.block_deallocate(size_t(1) << slab_log2_);
     }
 
-    void pool_clear_(Pool* pool) {
-        // Link all elements sequentially.
-        pool->first_free = pool->begin;
-        for (size_t index = 0; index + 1 < pool_size_; index++) {
-            std::byte* elem0 = pool->begin + (index + 0) * elem_size_;
-            std::byte* elem1 = pool->begin + (index + 1) * elem_size_;
-            std::memcpy(elem0, &elem1, sizeof(void*));
-        }
-        std::byte* elem0 = pool->begin + (pool_size_ - 1) * elem_size_;
-        std::byte* elem1 = nullptr;
-        std::memcpy(elem0, &elem1, sizeof(void*));
-        // Zero count.
+    void pool_clear_(Pool* pool) noexcept {
+        pool->first_free = nullptr;
+        pool->first_unused = pool_begin_(pool);
         pool->count = 0;
     }
 };
 
 /// A heap-allocated pool for a given object.
-template <typename Obj, typename Alloc = std::allocator<std::byte>>
-class ObjectHeapPool final : public HeapPool<Alloc> {
+template <
+        typename Obj,
+        typename Alloc = std::allocator<std::byte>,
+        typename Stats = NoMemoryStats>
+class ObjectHeapPool final : public HeapPool<Alloc, Stats> {
   public:
-    using Base = HeapPool<Alloc>;
+    using Base = HeapPool<Alloc, Stats>;
 
     ObjectHeapPool(size_t pool_size, const Alloc& alloc = Alloc())
         : Base(sizeof(Obj), pool_size, alloc) {
     }
 
-    ObjectHeapPool(ObjectHeapPool&& other) noexcept : Base(other) {
+    ObjectHeapPool(ObjectHeapPool&& other) noexcept
+        : Base(static_cast<Base&&>(other)) {
     }
 
     ObjectHeapPool(ObjectHeapPool&& other, const Alloc& alloc)
-        : Base(other, alloc) {
+        : Base(static_cast<Base&&>(other), alloc) {
     }
 
     ~ObjectHeapPool() = default;
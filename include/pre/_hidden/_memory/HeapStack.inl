@@ -9,7 +9,15 @@ namespace pre {
 /// where memory in use can be checkpointed and rolled back using stack-style
 /// push and pop operations.
 ///
-template <typename Alloc = std::allocator<std::byte>>
+/// \tparam Alloc
+/// Block allocator.
+///
+/// \tparam Stats
+/// Stats policy, either `NoMemoryStats` or `MemoryStats`.
+///
+template <
+        typename Alloc = std::allocator<std::byte>,
+        typename Stats = NoMemoryStats>
 struct HeapStack {
   public:
     typedef Alloc allocator_type;
@@ -29,7 +37,8 @@ struct HeapStack {
     HeapStack(HeapStack&& other) noexcept
         : block_size_(other.block_size_),
           block_tail_(steal(other.block_tail_)),
-          alloc_(std::move(other.alloc_)), pushes_(std::move(other.pushes_)) {
+          alloc_(std::move(other.alloc_)), pushes_(std::move(other.pushes_)),
+          stats_(steal(other.stats_)) {
     }
 
     ~HeapStack() {
@@ -46,18 +55,49 @@ struct HeapStack {
         block_tail_ = steal(other.block_tail_);
         alloc_ = std::move(other.alloc_);
         pushes_ = std::move(other.pushes_);
+        stats_ = steal(other.stats_);
         return *this;
     }
 
   public:
+    /// Allocate bytes, aligned to 16 bytes.
     void* allocate(size_t n) {
-        n = (n + 15U) & ~15U;
-        ensure_tail_can_allocate_(n);
-        void* ptr = block_tail_->top;
-        block_tail_->top += n;
+        return allocate(n, 16);
+    }
+
+    /// Allocate bytes with given alignment.
+    ///
+    /// \param[in] n
+    /// Size in bytes, rounded up to a multiple of 16.
+    ///
+    /// \param[in] align
+    /// Alignment in bytes, at least 16.
+    ///
+    /// \throw std::invalid_argument
+    /// If alignment is not a power of 2.
+    ///
+    void* allocate(size_t n, size_t align) {
+        if (!std::has_single_bit(align))
+            throw std::invalid_argument(__func__);
+        if (align < 16)
+            align = 16;
+        n = (n + 15U) & ~size_t(15);
+        Block* block = block_tail_;
+        std::byte* top = block->top;
+        std::byte* ptr = ensure_tail_can_allocate_(n, align);
+        if (block_tail_ != block)
+            top = block_tail_->begin;
+        block_tail_->top = ptr + n;
+        stats_.allocate(block_tail_->top - top);
         return ptr;
     }
 
+    /// Allocate given type, with its alignment.
+    template <typename T>
+    T* allocate(size_t count = 1) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
     void clear() noexcept {
         // Find head.
         Block* head = block_tail_;
@@ -77,6 +117,7 @@ struct HeapStack {
         block_tail_->next = nullptr;
         block_tail_->top = block_tail_->begin;
         pushes_.clear();
+        stats_.set_bytes(0);
     }
 
     /// Create scoped push object to automatically pop on destruction.
@@ -102,6 +143,18 @@ struct HeapStack {
             block->top = block->begin;
             block = block->next;
         }
+        stats_.set_bytes(bytes_());
+    }
+
+    /// Stats snapshot.
+    const MemoryStatsSnapshot& stats() const noexcept
+        requires(Stats::is_enabled) {
+        return stats_.snapshot();
+    }
+
+    /// Reset peak bytes to bytes in use.
+    void reset_peak() noexcept requires(Stats::is_enabled) {
+        stats_.reset_peak();
     }
 
   private:
@@ -129,6 +182,8 @@ struct HeapStack {
 
     RebindVector<std::pair<Block*, std::byte*>> pushes_;
 
+    [[no_unique_address]] Stats stats_;
+
   private:
     Block* block_allocate_(size_t least_n = 0) {
         if (least_n < block_size_)
@@ -140,27 +195,43 @@ struct HeapStack {
         block->begin = ptr + sizeof(Block);
         block->end = block->begin + least_n;
         block->top = block->begin;
+        stats_.block_allocate(least_n);
         return block;
     }
 
     void block_deallocate_(Block* block) {
+        stats_.block_deallocate(block->end - block->begin);
         alloc_.deallocate(
                 reinterpret_cast<std::byte*>(block),
                 sizeof(Block) + block->end - block->begin);
     }
 
-    void ensure_tail_can_allocate_(size_t n) {
-        if (block_tail_->top + n > block_tail_->end) {
+    /// Bytes in use, only computed if tracked.
+    size_t bytes_() const noexcept {
+        size_t bytes = 0;
+        if constexpr (Stats::is_enabled)
+            for (Block* block = block_tail_; block; block = block->prev)
+                bytes += block->top - block->begin;
+        return bytes;
+    }
+
+    std::byte* ensure_tail_can_allocate_(size_t n, size_t align) {
+        void* ptr = block_tail_->top;
+        size_t space = block_tail_->end - block_tail_->top;
+        if (!std::align(align, n, ptr, space)) {
             if (block_tail_->next) {
                 block_tail_ = block_tail_->next;
-                ensure_tail_can_allocate_(n); // Recurse.
+                return ensure_tail_can_allocate_(n, align); // Recurse.
             }
             else {
-                block_tail_->next = block_allocate_(n);
+                // Worst case padding, in case the block is not aligned.
+                block_tail_->next = block_allocate_(n + align - 1);
                 block_tail_->next->prev = block_tail_;
                 block_tail_ = block_tail_->next;
+                return ensure_tail_can_allocate_(n, align); // Recurse.
             }
         }
+        return static_cast<std::byte*>(ptr);
     }
 };
 
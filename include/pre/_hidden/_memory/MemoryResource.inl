@@ -0,0 +1,143 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A polymorphic memory resource drawing from a `HeapArena`.
+///
+/// Deallocation does nothing, as memory is only released by clearing,
+/// rewinding, or resetting the arena. The arena must outlive the resource.
+///
+template <
+        typename Alloc = std::allocator<std::byte>,
+        typename Stats = NoMemoryStats>
+class HeapArenaResource final : public std::pmr::memory_resource {
+  public:
+    explicit HeapArenaResource(HeapArena<Alloc, Stats>& arena) noexcept
+        : arena_(&arena) {
+    }
+
+    HeapArena<Alloc, Stats>& arena() const noexcept {
+        return *arena_;
+    }
+
+  private:
+    HeapArena<Alloc, Stats>* arena_;
+
+    void* do_allocate(size_t bytes, size_t align) override {
+        // Never return null, even for zero bytes.
+        return arena_->allocate(std::max<size_t>(bytes, 1), align);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {
+        // Do nothing
+    }
+
+    bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+/// A polymorphic memory resource drawing from a `HeapStack`.
+///
+/// Deallocation does nothing, as memory is only released by popping
+/// or clearing the stack. The stack must outlive the resource.
+///
+template <
+        typename Alloc = std::allocator<std::byte>,
+        typename Stats = NoMemoryStats>
+class HeapStackResource final : public std::pmr::memory_resource {
+  public:
+    explicit HeapStackResource(HeapStack<Alloc, Stats>& stack) noexcept
+        : stack_(&stack) {
+    }
+
+    HeapStack<Alloc, Stats>& stack() const noexcept {
+        return *stack_;
+    }
+
+  private:
+    HeapStack<Alloc, Stats>* stack_;
+
+    void* do_allocate(size_t bytes, size_t align) override {
+        return stack_->allocate(bytes, align);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {
+        // Do nothing
+    }
+
+    bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+/// A polymorphic memory resource drawing from a `SizeClassHeapPool`.
+///
+/// Allocation and deallocation are constant time. Allocations that
+/// are larger than `MaxSize`, or that need alignment beyond 16 bytes, go
+/// to the upstream resource.
+///
+/// \note
+/// Like `std::pmr::unsynchronized_pool_resource`, this is not safe
+/// to use from multiple threads at once.
+///
+template <typename Alloc = std::allocator<std::byte>>
+class HeapPoolResource final : public std::pmr::memory_resource {
+  public:
+    /// Maximum size class.
+    static constexpr size_t MaxSize = SizeClassHeapPool<Alloc>::MaxSize;
+
+    HeapPoolResource(
+            std::pmr::memory_resource* upstream =
+                    std::pmr::get_default_resource(),
+            const Alloc& alloc = Alloc())
+        : upstream_(upstream), pool_(alloc) {
+    }
+
+    /// Upstream resource.
+    std::pmr::memory_resource* upstream_resource() const noexcept {
+        return upstream_;
+    }
+
+    /// Pool.
+    const SizeClassHeapPool<Alloc>& pool() const noexcept {
+        return pool_;
+    }
+
+    /// Clear the pool. Upstream allocations are not released.
+    void clear() noexcept {
+        pool_.clear();
+    }
+
+  private:
+    std::pmr::memory_resource* upstream_;
+
+    SizeClassHeapPool<Alloc> pool_;
+
+    static bool is_pooled_(size_t bytes, size_t align) noexcept {
+        return bytes <= MaxSize && align <= 16;
+    }
+
+    void* do_allocate(size_t bytes, size_t align) override {
+        if (!is_pooled_(bytes, align))
+            return upstream_->allocate(bytes, align);
+        return pool_.allocate(bytes, align);
+    }
+
+    void do_deallocate(void* ptr, size_t bytes, size_t align) override {
+        if (!is_pooled_(bytes, align))
+            upstream_->deallocate(ptr, bytes, align);
+        else
+            pool_.deallocate(ptr, bytes, align);
+    }
+
+    bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+} // namespace pre
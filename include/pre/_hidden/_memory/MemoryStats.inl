@@ -0,0 +1,110 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A snapshot of memory container statistics.
+struct MemoryStatsSnapshot {
+  public:
+    /// Bytes in use, including alignment padding.
+    size_t bytes = 0;
+
+    /// Peak bytes in use.
+    size_t peak_bytes = 0;
+
+    /// Number of blocks owned.
+    size_t block_count = 0;
+
+    /// Bytes in blocks owned, in use or not.
+    size_t block_bytes = 0;
+
+    /// Number of allocations ever.
+    size_t allocation_count = 0;
+
+  public:
+    /// Fragmentation, i.e., the fraction of bytes in blocks owned that
+    /// are not in use. This counts wasted tail space in full blocks,
+    /// free elements, and free blocks.
+    double fragmentation() const noexcept {
+        return block_bytes > 0 ? 1.0 - double(bytes) / double(block_bytes)
+                               : 0.0;
+    }
+
+    MemoryStatsSnapshot& operator+=(const MemoryStatsSnapshot& other) noexcept {
+        bytes += other.bytes;
+        peak_bytes += other.peak_bytes;
+        block_count += other.block_count;
+        block_bytes += other.block_bytes;
+        allocation_count += other.allocation_count;
+        return *this;
+    }
+};
+
+/// A memory stats policy that tracks nothing.
+///
+/// This is the default policy of `HeapArena`, `HeapStack`, and
+/// `HeapPool`. It is empty, and every event is a no-op, so it costs
+/// nothing.
+///
+struct NoMemoryStats {
+    static constexpr bool is_enabled = false;
+    constexpr void allocate(size_t) noexcept {
+    }
+    constexpr void deallocate(size_t) noexcept {
+    }
+    constexpr void set_bytes(size_t) noexcept {
+    }
+    constexpr void block_allocate(size_t) noexcept {
+    }
+    constexpr void block_deallocate(size_t) noexcept {
+    }
+};
+
+/// A memory stats policy that tracks everything in a
+/// `MemoryStatsSnapshot`.
+///
+/// \note
+/// This is not thread safe, just like the containers that use it.
+///
+struct MemoryStats {
+  public:
+    static constexpr bool is_enabled = true;
+
+    void allocate(size_t bytes) noexcept {
+        set_bytes(snapshot_.bytes + bytes);
+        snapshot_.allocation_count++;
+    }
+
+    void deallocate(size_t bytes) noexcept {
+        snapshot_.bytes -= bytes;
+    }
+
+    void set_bytes(size_t bytes) noexcept {
+        snapshot_.bytes = bytes;
+        snapshot_.peak_bytes = std::max(snapshot_.peak_bytes, bytes);
+    }
+
+    void block_allocate(size_t bytes) noexcept {
+        snapshot_.block_count++;
+        snapshot_.block_bytes += bytes;
+    }
+
+    void block_deallocate(size_t bytes) noexcept {
+        snapshot_.block_count--;
+        snapshot_.block_bytes -= bytes;
+    }
+
+    /// Reset peak bytes to bytes in use, e.g., at the start of a frame.
+    void reset_peak() noexcept {
+        snapshot_.peak_bytes = snapshot_.bytes;
+    }
+
+    const MemoryStatsSnapshot& snapshot() const noexcept {
+        return snapshot_;
+    }
+
+  private:
+    MemoryStatsSnapshot snapshot_ = {};
+};
+
+} // namespace pre
@@ -0,0 +1,323 @@
+/*-*- C++ -*-*/
+#pragma once
+
+#if __linux__
+
+namespace pre {
+
+/// A reserved range of virtual memory pages.
+///
+/// This reserves a large virtual range up front, without committing
+/// any memory, and hands out page-aligned sub-ranges from it. Each
+/// sub-range is made accessible on allocation, but physical memory is
+/// still only committed by the kernel on first touch. On deallocation,
+/// the physical memory is returned with `madvise(MADV_DONTNEED)` and
+/// the sub-range is made inaccessible again, but stays reserved for
+/// reuse.
+///
+/// \note
+/// With `HugePages::Explicit`, sub-ranges are mapped with `MAP_HUGETLB`,
+/// which requires huge pages to be configured by the system
+/// administrator. If that fails, this falls back to transparent huge
+/// pages, and from then on rounds smaller sub-ranges to the page size
+/// rather than the huge page size. With `HugePages::Transparent`, sub-ranges of at least one
+/// huge page are aligned to huge page boundaries and advised with
+/// `MADV_HUGEPAGE`. In either case, containers should use block sizes
+/// that are multiples of `HugePageSize`.
+///
+class PageReserve {
+  public:
+    enum class HugePages { None, Transparent, Explicit };
+
+    /// Default capacity of 64GB.
+    static constexpr size_t DefaultCapacity = size_t(1) << 36;
+
+    /// Huge page size of 2MB.
+    static constexpr size_t HugePageSize = size_t(1) << 21;
+
+    /// Constructor.
+    ///
+    /// \param[in] capacity
+    /// Capacity in bytes, which is only virtual.
+    ///
+    /// \param[in] huge_pages
+    /// Huge page policy.
+    ///
+    /// \throw std::bad_alloc
+    /// If the range cannot be reserved.
+    ///
+    explicit PageReserve(
+            size_t capacity = DefaultCapacity,
+            HugePages huge_pages = HugePages::None)
+        : huge_pages_(huge_pages) {
+        page_size_ = size_t(::sysconf(_SC_PAGESIZE));
+        granularity_ =
+                huge_pages_ == HugePages::Explicit ? HugePageSize : page_size_;
+        capacity_ = (capacity + HugePageSize - 1) & ~(HugePageSize - 1);
+        void* ptr = ::mmap(
+                nullptr, capacity_, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+        base_ = static_cast<std::byte*>(ptr);
+        free_ranges_.emplace(base_, capacity_);
+    }
+
+    PageReserve(const PageReserve&) = delete;
+
+    ~PageReserve() {
+        ::munmap(base_, capacity_);
+    }
+
+    PageReserve& operator=(const PageReserve&) = delete;
+
+  public:
+    /// Default reserve, shared by default-constructed page allocators.
+    static const std::shared_ptr<PageReserve>& default_reserve() {
+        static std::shared_ptr<PageReserve> reserve =
+                std::make_shared<PageReserve>();
+        return reserve;
+    }
+
+    /// Capacity in bytes.
+    size_t capacity() const noexcept {
+        return capacity_;
+    }
+
+    /// Page size in bytes, i.e., the size of the smallest sub-range.
+    size_t page_size() const noexcept {
+        return page_size_;
+    }
+
+    /// Huge page policy, possibly downgraded from `HugePages::Explicit`
+    /// to `HugePages::Transparent` if explicit huge pages are not
+    /// available.
+    HugePages huge_pages() const noexcept {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return huge_pages_;
+    }
+
+    /// Bytes currently allocated, including rounding to pages.
+    size_t allocated() const noexcept {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return allocated_;
+    }
+
+    /// Allocate sub-range.
+    ///
+    /// \param[in] size
+    /// Size in bytes, rounded up to a multiple of the page size.
+    ///
+    /// \param[in] align
+    /// Alignment in bytes, at least the page size.
+    ///
+    /// \throw std::bad_alloc
+    /// If there is no free sub-range large enough, or if the kernel
+    /// refuses to map it.
+    ///
+    void* allocate(size_t size, size_t align) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        size = round_(size);
+        align = std::max(align, granularity_);
+        if (huge_pages_ != HugePages::None && size >= HugePageSize)
+            align = std::max(align, HugePageSize);
+        for (auto itr = free_ranges_.begin(); itr != free_ranges_.end();
+             ++itr) {
+            auto [begin, range_size] = *itr;
+            std::byte* end = begin + range_size;
+            auto pos = reinterpret_cast<std::byte*>(
+                    (std::uintptr_t(begin) + align - 1) & ~(align - 1));
+            if (pos > end || size_t(end - pos) < size)
+                continue;
+            // Remember the size if rounded to huge pages, in case of a
+            // downgrade before deallocation.
+            bool is_huge = granularity_ == HugePageSize;
+            if (is_huge)
+                huge_sizes_.emplace(pos, size);
+            try {
+                commit_(pos, size);
+            }
+            catch (...) {
+                if (is_huge)
+                    huge_sizes_.erase(pos);
+                throw;
+            }
+            // Split free range.
+            free_ranges_.erase(itr);
+            if (pos > begin)
+                free_ranges_.emplace(begin, pos - begin);
+            if (pos + size < end)
+                free_ranges_.emplace(pos + size, end - (pos + size));
+            allocated_ += size;
+            return pos;
+        }
+        throw std::bad_alloc();
+    }
+
+    /// Deallocate sub-range, returning its memory to the system.
+    void deallocate(void* ptr, size_t size) noexcept {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::byte* pos = static_cast<std::byte*>(ptr);
+        if (auto itr = huge_sizes_.find(pos); itr != huge_sizes_.end()) {
+            size = itr->second;
+            huge_sizes_.erase(itr);
+        }
+        else {
+            size = round_(size);
+        }
+        decommit_(pos, size);
+        allocated_ -= size;
+        // Insert free range, merging with neighbors.
+        auto next = free_ranges_.lower_bound(pos);
+        if (next != free_ranges_.end() && pos + size == next->first) {
+            size += next->second;
+            next = free_ranges_.erase(next);
+        }
+        if (next != free_ranges_.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == pos) {
+                prev->second += size;
+                return;
+            }
+        }
+        free_ranges_.emplace_hint(next, pos, size);
+    }
+
+  private:
+    size_t round_(size_t size) const noexcept {
+        return (size + granularity_ - 1) & ~(granularity_ - 1);
+    }
+
+    void commit_(std::byte* pos, size_t size) {
+        if (huge_pages_ == HugePages::Explicit) {
+            if (::mmap(pos, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB,
+                       -1, 0) != MAP_FAILED)
+                return;
+            // Fall back to transparent huge pages, which need not round
+            // every sub-range to huge pages. Note the failed fixed
+            // mapping may have unmapped the range, so reserve it again.
+            huge_pages_ = HugePages::Transparent;
+            granularity_ = page_size_;
+            if (::mmap(pos, size, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+                       -1, 0) == MAP_FAILED)
+                throw std::bad_alloc();
+        }
+        if (::mprotect(pos, size, PROT_READ | PROT_WRITE) != 0)
+            throw std::bad_alloc();
+        if (huge_pages_ == HugePages::Transparent && size >= HugePageSize)
+            ::madvise(pos, size, MADV_HUGEPAGE);
+    }
+
+    void decommit_(std::byte* pos, size_t size) noexcept {
+        // Return physical memory, then make inaccessible again. If
+        // this is a huge page mapping the kernel does not support
+        // advising, replace it instead.
+        if (::madvise(pos, size, MADV_DONTNEED) != 0 ||
+            ::mprotect(pos, size, PROT_NONE) != 0)
+            ::mmap(pos, size, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+                   -1, 0);
+    }
+
+  private:
+    mutable std::mutex mutex_;
+
+    std::byte* base_ = nullptr;
+
+    size_t capacity_ = 0;
+
+    size_t page_size_ = 0;
+
+    /// Granularity, either the page size or the huge page size.
+    size_t granularity_ = 0;
+
+    size_t allocated_ = 0;
+
+    HugePages huge_pages_ = HugePages::None;
+
+    /// Free ranges by address.
+    std::map<std::byte*, size_t> free_ranges_;
+
+    /// Sizes of allocated sub-ranges by address, if rounded to the huge
+    /// page size, since the granularity may since have been downgraded.
+    std::map<std::byte*, size_t> huge_sizes_;
+};
+
+/// A standard-compatible allocator of pages from a `PageReserve`.
+///
+/// This is meant to be the block allocator of `HeapArena`, `HeapStack`,
+/// or `HeapPool`, e.g., `HeapArena<PageAllocator<std::byte>>`. Allocations
+/// of at least one page come from the reserve, and so `reset()` on the
+/// container returns its memory to the system. Smaller allocations, such
+/// as the bookkeeping vectors of the containers, come from `operator new`.
+///
+template <typename T>
+class PageAllocator {
+  public:
+    typedef T value_type;
+
+    typedef std::true_type propagate_on_container_copy_assignment;
+
+    typedef std::true_type propagate_on_container_move_assignment;
+
+    typedef std::true_type propagate_on_container_swap;
+
+    typedef std::false_type is_always_equal;
+
+  public:
+    /// Default constructor, using the default reserve.
+    PageAllocator() : reserve_(PageReserve::default_reserve()) {
+    }
+
+    PageAllocator(std::shared_ptr<PageReserve> reserve) noexcept
+        : reserve_(std::move(reserve)) {
+    }
+
+    template <typename U>
+    PageAllocator(const PageAllocator<U>& other) noexcept
+        : reserve_(other.reserve_) {
+    }
+
+    [[nodiscard]] T* allocate(size_t n) {
+        size_t size = sizeof(T) * n;
+        if (size < reserve_->page_size())
+            return static_cast<T*>(
+                    ::operator new(size, std::align_val_t(alignof(T))));
+        return static_cast<T*>(reserve_->allocate(size, alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        size_t size = sizeof(T) * n;
+        if (size < reserve_->page_size())
+            ::operator delete(ptr, std::align_val_t(alignof(T)));
+        else
+            reserve_->deallocate(ptr, size);
+    }
+
+    /// Reserve.
+    const std::shared_ptr<PageReserve>& reserve() const noexcept {
+        return reserve_;
+    }
+
+    template <typename U>
+    bool operator==(const PageAllocator<U>& other) const noexcept {
+        return reserve_ == other.reserve_;
+    }
+
+    template <typename U>
+    bool operator!=(const PageAllocator<U>& other) const noexcept {
+        return reserve_ != other.reserve_;
+    }
+
+  private:
+    std::shared_ptr<PageReserve> reserve_;
+
+    template <typename>
+    friend class PageAllocator;
+};
+
+} // namespace pre
+
+#endif // #if __linux__
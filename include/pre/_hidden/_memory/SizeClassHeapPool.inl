@@ -0,0 +1,171 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A snapshot of size class heap pool statistics.
+struct SizeClassHeapPoolStats {
+  public:
+    /// Statistics of one size class.
+    struct Class {
+        /// Element size in bytes.
+        size_t elem_size = 0;
+
+        /// Number of elements allocated.
+        size_t count = 0;
+
+        /// Number of elements in all pools, allocated or not.
+        size_t capacity = 0;
+
+        /// Number of pools.
+        size_t pool_count = 0;
+
+        /// Occupancy, i.e., the fraction of capacity allocated.
+        double occupancy() const noexcept {
+            return capacity > 0 ? double(count) / double(capacity) : 0.0;
+        }
+    };
+
+    /// Size classes.
+    std::vector<Class> classes = {};
+
+    /// Number of large allocations.
+    size_t large_count = 0;
+
+    /// Bytes in large allocations.
+    size_t large_bytes = 0;
+};
+
+/// A heap-allocated small-object allocator with size classes.
+///
+/// Each size class is backed by a `HeapPool`. Size classes step by 8
+/// bytes up to 64 bytes, then by 4 steps per power of 2 up to `MaxSize`,
+/// so that rounding up never wastes more than 20% beyond 64 bytes.
+/// Finding the size class of a size is constant time, and so are both
+/// allocation and sized deallocation. Larger sizes, or alignments
+/// beyond 16 bytes, fall back to aligned `operator new`.
+///
+/// \note
+/// Elements are aligned to the largest power of 2 dividing their class
+/// size, up to 16. To ask for more, pass the alignment explicitly, and
+/// pass the same size and alignment to deallocate.
+///
+template <typename Alloc = std::allocator<std::byte>>
+class SizeClassHeapPool {
+  public:
+    typedef Alloc allocator_type;
+
+    /// Maximum size class.
+    static constexpr size_t MaxSize = 1024;
+
+    /// Size class count.
+    static constexpr size_t ClassCount = 8 + 4 * (std::bit_width(MaxSize) - 7);
+
+    /// Constructor.
+    ///
+    /// \param[in] alloc
+    /// Allocator for the pools.
+    ///
+    explicit SizeClassHeapPool(const Alloc& alloc = Alloc()) {
+        pools_.reserve(ClassCount);
+        for (size_t index = 0; index < ClassCount; index++)
+            pools_.emplace_back(class_size(index), 0, alloc);
+    }
+
+    SizeClassHeapPool(const SizeClassHeapPool&) = delete;
+
+    SizeClassHeapPool(SizeClassHeapPool&&) noexcept = default;
+
+    SizeClassHeapPool& operator=(const SizeClassHeapPool&) = delete;
+
+    SizeClassHeapPool& operator=(SizeClassHeapPool&&) noexcept = default;
+
+  public:
+    /// Size class index of given size in bytes, at most `MaxSize`.
+    static constexpr size_t class_of(size_t size) noexcept {
+        if (size <= 64)
+            return size > 0 ? (size - 1) / 8 : 0;
+        size_t width = std::bit_width(size - 1);
+        return 8 + 4 * (width - 7) + ((size - 1) >> (width - 3)) - 4;
+    }
+
+    /// Size in bytes of given size class index.
+    static constexpr size_t class_size(size_t index) noexcept {
+        if (index < 8)
+            return 8 * (index + 1);
+        index -= 8;
+        return (5 + index % 4) << (index / 4 + 4);
+    }
+
+    /// Allocate.
+    ///
+    /// \param[in] size
+    /// Size in bytes.
+    ///
+    /// \param[in] align
+    /// Alignment in bytes.
+    ///
+    /// \throw std::invalid_argument
+    /// If alignment is not a power of 2.
+    ///
+    [[nodiscard]] void* allocate(size_t size, size_t align = 1) {
+        if (!std::has_single_bit(align))
+            throw std::invalid_argument(__func__);
+        size = (size + align - 1) & ~(align - 1);
+        if (size > MaxSize || align > 16) {
+            large_count_++;
+            large_bytes_ += size;
+            return ::operator new(size, std::align_val_t(align));
+        }
+        return pools_[class_of(size)].allocate();
+    }
+
+    /// Deallocate in constant time, given the same size and alignment
+    /// as passed to allocate.
+    void deallocate(void* ptr, size_t size, size_t align = 1) {
+        if (ptr == nullptr)
+            return;
+        size = (size + align - 1) & ~(align - 1);
+        if (size > MaxSize || align > 16) {
+            large_count_--;
+            large_bytes_ -= size;
+            ::operator delete(ptr, size, std::align_val_t(align));
+            return;
+        }
+        pools_[class_of(size)].deallocate(ptr);
+    }
+
+    /// Clear all pools. Large allocations are not affected.
+    void clear() noexcept {
+        for (HeapPool<Alloc>& pool : pools_)
+            pool.clear();
+    }
+
+    /// Clear and deallocate all pools. Large allocations are not affected.
+    void reset() noexcept {
+        for (HeapPool<Alloc>& pool : pools_)
+            pool.reset();
+    }
+
+    /// Statistics.
+    SizeClassHeapPoolStats stats() const {
+        SizeClassHeapPoolStats res;
+        res.classes.reserve(ClassCount);
+        for (const HeapPool<Alloc>& pool : pools_)
+            res.classes.push_back(
+                    {pool.elem_size(), pool.count(), pool.capacity(),
+                     pool.pool_count()});
+        res.large_count = large_count_;
+        res.large_bytes = large_bytes_;
+        return res;
+    }
+
+  private:
+    std::vector<HeapPool<Alloc>> pools_;
+
+    size_t large_count_ = 0;
+
+    size_t large_bytes_ = 0;
+};
+
+} // namespace pre
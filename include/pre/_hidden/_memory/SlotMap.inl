@@ -0,0 +1,312 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A slot map.
+///
+/// A container of values referenced by generational handles rather
+/// than pointers. The values are densely packed in insertion order,
+/// modulo erasure, so iterating over them is as fast as iterating over
+/// a vector. Each handle names a slot and the generation of the slot
+/// when the value was inserted. Erasing a value swaps the last value
+/// into its place and pops the back, in constant time, and bumps the
+/// generation of its slot, so that any handle to it becomes stale.
+///
+/// \tparam Value
+/// Value type.
+///
+/// \tparam Int
+/// Handle integer type, either 32 or 64 bits. With 32 bits, handles
+/// have 24 index bits and 8 generation bits. With 64 bits, handles
+/// have 32 index bits and 32 generation bits. If the generation of a
+/// slot runs out, the slot is retired instead of reused, so that stale
+/// handles are always detected.
+///
+/// \tparam Alloc
+/// Allocator.
+///
+/// \note
+/// Inserting and erasing values moves other values around, so pointers
+/// and references to values are only valid until the next insert or
+/// erase. Handles are always valid until their value is erased.
+///
+template <
+        typename Value,
+        std::unsigned_integral Int = std::uint64_t,
+        typename Alloc = std::allocator<Value>>
+class SlotMap {
+  public:
+    // Sanity check.
+    static_assert(sizeof(Int) == 4 || sizeof(Int) == 8);
+
+    /// Index bits.
+    static constexpr int IndexBits = sizeof(Int) == 4 ? 24 : 32;
+
+    /// Maximum slot count.
+    static constexpr size_t MaxSlots = (size_t(1) << IndexBits) - 1;
+
+    /// Maximum generation.
+    static constexpr Int MaxGeneration = Int(~Int(0)) >> IndexBits;
+
+    /// A handle.
+    struct Handle {
+      public:
+        /// Value, where zero is the null handle.
+        Int value = 0;
+
+      public:
+        constexpr Handle() noexcept = default;
+
+        constexpr Handle(Int index, Int generation) noexcept
+            : value((generation << IndexBits) | index) {
+        }
+
+        /// Index of slot.
+        constexpr Int index() const noexcept {
+            return value & Int(MaxSlots);
+        }
+
+        /// Generation of slot, never zero unless null.
+        constexpr Int generation() const noexcept {
+            return value >> IndexBits;
+        }
+
+        /// Not null?
+        constexpr operator bool() const noexcept {
+            return value != 0;
+        }
+
+        constexpr auto operator<=>(const Handle&) const noexcept = default;
+    };
+
+    typedef Value value_type;
+
+    typedef size_t size_type;
+
+    typedef typename std::vector<Value, Alloc>::iterator iterator;
+
+    typedef typename std::vector<Value, Alloc>::const_iterator const_iterator;
+
+  public:
+    SlotMap(const Alloc& alloc = Alloc())
+        : values_(alloc), value_slots_(alloc), slots_(alloc) {
+    }
+
+  public:
+    /// \name Container API
+    /** \{ */
+
+    size_t size() const noexcept {
+        return values_.size();
+    }
+
+    bool empty() const noexcept {
+        return values_.empty();
+    }
+
+    /// Reserve space for given number of values.
+    void reserve(size_t count) {
+        values_.reserve(count);
+        value_slots_.reserve(count);
+        slots_.reserve(count);
+    }
+
+    /// Clear, making all handles stale.
+    void clear() noexcept {
+        for (Int index : value_slots_)
+            release_(index);
+        values_.clear();
+        value_slots_.clear();
+    }
+
+    /// Densely packed values.
+    std::span<Value> values() noexcept {
+        return values_;
+    }
+
+    /// Densely packed values, const variant.
+    std::span<const Value> values() const noexcept {
+        return values_;
+    }
+
+    iterator begin() noexcept {
+        return values_.begin();
+    }
+
+    const_iterator begin() const noexcept {
+        return values_.begin();
+    }
+
+    iterator end() noexcept {
+        return values_.end();
+    }
+
+    const_iterator end() const noexcept {
+        return values_.end();
+    }
+
+    /** \} */
+
+  public:
+    /// \name Slot map
+    /** \{ */
+
+    /// Emplace value.
+    ///
+    /// \throw std::length_error
+    /// If out of slots.
+    ///
+    template <typename... Args>
+    Handle emplace(Args&&... args) {
+        if (free_ == Int(MaxSlots)) {
+            if (slots_.size() >= MaxSlots)
+                throw std::length_error(__func__);
+            slots_.push_back({free_, 1});
+            free_ = Int(slots_.size() - 1);
+        }
+        values_.emplace_back(std::forward<Args>(args)...);
+        try {
+            value_slots_.push_back(free_);
+        } catch (...) {
+            values_.pop_back();
+            throw;
+        }
+        Int index = free_;
+        Slot& slot = slots_[index];
+        free_ = slot.index;
+        slot.index = Int(values_.size() - 1);
+        return {index, slot.generation};
+    }
+
+    /// Insert value.
+    Handle insert(const Value& value) {
+        return emplace(value);
+    }
+
+    /// Insert value, move variant.
+    Handle insert(Value&& value) {
+        return emplace(std::move(value));
+    }
+
+    /// Contains value of handle, i.e., the handle is not stale?
+    bool contains(Handle handle) const noexcept {
+        return find_(handle) != nullptr;
+    }
+
+    /// Get value of handle, or null if stale.
+    Value* get(Handle handle) noexcept {
+        const Slot* slot = find_(handle);
+        return slot ? &values_[slot->index] : nullptr;
+    }
+
+    /// Get value of handle, or null if stale, const variant.
+    const Value* get(Handle handle) const noexcept {
+        const Slot* slot = find_(handle);
+        return slot ? &values_[slot->index] : nullptr;
+    }
+
+    /// Get value of handle.
+    ///
+    /// \throw std::out_of_range
+    /// If handle is stale.
+    ///
+    Value& at(Handle handle) {
+        Value* value = get(handle);
+        if (!value)
+            throw std::out_of_range(__func__);
+        return *value;
+    }
+
+    /// Get value of handle, const variant.
+    ///
+    /// \throw std::out_of_range
+    /// If handle is stale.
+    ///
+    const Value& at(Handle handle) const {
+        const Value* value = get(handle);
+        if (!value)
+            throw std::out_of_range(__func__);
+        return *value;
+    }
+
+    /// Handle of value at given position in the densely packed values.
+    Handle handle_at(size_t pos) const noexcept {
+        Int index = value_slots_[pos];
+        return {index, slots_[index].generation};
+    }
+
+    /// Erase value of handle, in constant time, by moving the last
+    /// value into its place.
+    ///
+    /// \returns
+    /// Returns false if the handle is stale.
+    ///
+    bool erase(Handle handle) {
+        const Slot* slot = find_(handle);
+        if (!slot)
+            return false;
+        size_t pos = slot->index;
+        size_t last = values_.size() - 1;
+        if (pos != last) {
+            values_[pos] = std::move(values_[last]);
+            value_slots_[pos] = value_slots_[last];
+            slots_[value_slots_[pos]].index = Int(pos);
+        }
+        values_.pop_back();
+        value_slots_.pop_back();
+        release_(handle.index());
+        return true;
+    }
+
+    /** \} */
+
+  private:
+    /// A slot.
+    struct Slot {
+        /// Position of value if live, or next free slot if free.
+        Int index = 0;
+
+        /// Generation, or zero if retired.
+        Int generation = 0;
+    };
+
+    template <typename T>
+    using RebindAlloc =
+            typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+
+    /// Values.
+    std::vector<Value, Alloc> values_;
+
+    /// Slot of each value.
+    std::vector<Int, RebindAlloc<Int>> value_slots_;
+
+    /// Slots.
+    std::vector<Slot, RebindAlloc<Slot>> slots_;
+
+    /// First free slot, or `MaxSlots` if none.
+    Int free_ = Int(MaxSlots);
+
+  private:
+    const Slot* find_(Handle handle) const noexcept {
+        Int index = handle.index();
+        if (index >= slots_.size() ||
+            slots_[index].generation != handle.generation() ||
+            handle.generation() == 0)
+            return nullptr;
+        return &slots_[index];
+    }
+
+    void release_(Int index) noexcept {
+        Slot& slot = slots_[index];
+        if (slot.generation == MaxGeneration) {
+            slot.generation = 0; // Retire.
+            return;
+        }
+        slot.generation++;
+        slot.index = free_;
+        free_ = index;
+    }
+};
+
+} // namespace pre
@@ -0,0 +1,295 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A static multi-producer multi-consumer queue.
+///
+/// A lock-free bounded queue (first-in first-out), safe to push and
+/// pop from any number of threads at once. This is the queue of Dmitry
+/// Vyukov, where each cell of a ring buffer carries a sequence number
+/// saying whether it is ready to be pushed into or popped from on the
+/// current lap around the ring. Producers and consumers each claim a
+/// cell with one compare-and-swap on their own position counter, so
+/// they never contend with each other except when the queue is nearly
+/// full or nearly empty.
+///
+/// \note
+/// The capacity must be a power of 2. Elements must be nothrow move
+/// constructible, so that a claimed cell is always filled.
+///
+/// \note
+/// Unlike `StaticQueue`, this is not array-like, since there is no
+/// meaningful way to index elements another thread may pop at any time.
+///
+template <typename Value, size_t MaxSize>
+struct StaticMpmcQueue {
+  public:
+    // Sanity check.
+    static_assert(MaxSize > 0 && (MaxSize & (MaxSize - 1)) == 0);
+
+    // Sanity check.
+    static_assert(std::is_nothrow_move_constructible_v<Value>);
+
+  public:
+    StaticMpmcQueue() noexcept {
+        for (size_t index = 0; index < MaxSize; index++)
+            cells_[index].sequence.store(index, std::memory_order_relaxed);
+    }
+
+    StaticMpmcQueue(const StaticMpmcQueue&) = delete;
+
+    ~StaticMpmcQueue() {
+        clear();
+    }
+
+  public:
+    /// \name Container API
+    /** \{ */
+
+    /// Size.
+    ///
+    /// \note
+    /// If other threads are pushing or popping, this is only a snapshot.
+    ///
+    size_t size() const noexcept {
+        size_t pop_pos = pop_pos_.load(std::memory_order_relaxed);
+        size_t push_pos = push_pos_.load(std::memory_order_relaxed);
+        return push_pos > pop_pos ? std::min(push_pos - pop_pos, MaxSize) : 0;
+    }
+
+    constexpr size_t max_size() const noexcept {
+        return MaxSize;
+    }
+
+    constexpr size_t capacity() const noexcept {
+        return MaxSize;
+    }
+
+    /// Empty?
+    ///
+    /// \note
+    /// If other threads are pushing or popping, this is only a snapshot.
+    ///
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    /// Clear.
+    ///
+    /// \note
+    /// This is only safe to call if no other threads are pushing.
+    ///
+    void clear() noexcept {
+        while (try_pop_destroy_())
+            continue;
+    }
+
+    /** \} */
+
+  public:
+    /// \name Queue
+    /** \{ */
+
+    /// Try to push top/back value.
+    ///
+    /// \returns
+    /// Returns true if successful, false if full. If false, the
+    /// value is not moved from.
+    ///
+    bool try_push(const Value& value) {
+        return try_emplace(value);
+    }
+
+    /// Try to push top/back value, move variant.
+    ///
+    /// \returns
+    /// Returns true if successful, false if full. If false, the
+    /// value is not moved from.
+    ///
+    bool try_push(Value&& value) noexcept {
+        Cell* cell = claim_push_();
+        if (!cell)
+            return false;
+        cell->construct(std::move(value));
+        return true;
+    }
+
+    /// Try to emplace top/back value.
+    ///
+    /// \returns
+    /// Returns true if successful, false if full.
+    ///
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        if constexpr (std::is_nothrow_constructible_v<Value, Args&&...>) {
+            Cell* cell = claim_push_();
+            if (!cell)
+                return false;
+            cell->construct(std::forward<Args>(args)...);
+            return true;
+        }
+        else {
+            // Construct first, since a claimed cell must be filled.
+            Value value(std::forward<Args>(args)...);
+            return try_push(std::move(value));
+        }
+    }
+
+    /// Try to pop bottom/front value.
+    ///
+    /// \param[out] value
+    /// Value, only assigned if successful.
+    ///
+    /// \returns
+    /// Returns true if successful, false if empty.
+    ///
+    bool try_pop(Value& value) {
+        std::optional<Value> res = try_pop();
+        if (!res)
+            return false;
+        value = std::move(*res);
+        return true;
+    }
+
+    /// Try to pop bottom/front value.
+    ///
+    /// \returns
+    /// Returns value if successful, `std::nullopt` if empty.
+    ///
+    std::optional<Value> try_pop() noexcept {
+        size_t pos = 0;
+        Cell* cell = claim_pop_(pos);
+        if (!cell)
+            return std::nullopt;
+        std::optional<Value> res(std::move(*cell->get()));
+        cell->destroy(pos + MaxSize);
+        return res;
+    }
+
+    /// Push top/back value.
+    ///
+    /// \throw std::length_error  If full.
+    ///
+    void push(const Value& value) {
+        if (!try_push(value))
+            throw std::length_error(__func__);
+    }
+
+    /// Push top/back value, move variant.
+    ///
+    /// \throw std::length_error  If full.
+    ///
+    void push(Value&& value) {
+        if (!try_push(std::move(value)))
+            throw std::length_error(__func__);
+    }
+
+    /// Pop and return bottom/front value.
+    ///
+    /// \throw std::runtime_error  If empty.
+    ///
+    Value pop() {
+        std::optional<Value> res = try_pop();
+        if (!res)
+            throw std::runtime_error(__func__);
+        return std::move(*res);
+    }
+
+    /** \} */
+
+  private:
+    /// A cell.
+    struct Cell {
+        /// Sequence number.
+        ///
+        /// If equal to the position, the cell is ready to be pushed
+        /// into. If equal to the position plus 1, the cell is ready to
+        /// be popped from.
+        ///
+        std::atomic_size_t sequence = {};
+
+        alignas(Value) std::byte storage[sizeof(Value)];
+
+        Value* get() noexcept {
+            return std::launder(reinterpret_cast<Value*>(&storage[0]));
+        }
+
+        template <typename... Args>
+        void construct(Args&&... args) noexcept {
+            size_t pos = sequence.load(std::memory_order_relaxed);
+            ::new (&storage[0]) Value(std::forward<Args>(args)...);
+            sequence.store(pos + 1, std::memory_order_release);
+        }
+
+        void destroy(size_t next) noexcept {
+            get()->~Value();
+            sequence.store(next, std::memory_order_release);
+        }
+    };
+
+    /// Claim cell to push into, or return null if full.
+    Cell* claim_push_() noexcept {
+        size_t pos = push_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & (MaxSize - 1)];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = std::intptr_t(seq) - std::intptr_t(pos);
+            if (diff == 0) {
+                if (push_pos_.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed))
+                    return &cell;
+            }
+            else if (diff < 0) {
+                return nullptr;
+            }
+            else {
+                pos = push_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Claim cell to pop from, or return null if empty.
+    Cell* claim_pop_(size_t& pos) noexcept {
+        pos = pop_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & (MaxSize - 1)];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = std::intptr_t(seq) - std::intptr_t(pos + 1);
+            if (diff == 0) {
+                if (pop_pos_.compare_exchange_weak(
+                            pos, pos + 1, std::memory_order_relaxed))
+                    return &cell;
+            }
+            else if (diff < 0) {
+                return nullptr;
+            }
+            else {
+                pos = pop_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop_destroy_() noexcept {
+        size_t pos = 0;
+        Cell* cell = claim_pop_(pos);
+        if (!cell)
+            return false;
+        cell->destroy(pos + MaxSize);
+        return true;
+    }
+
+  private:
+    Cell cells_[MaxSize];
+
+    /// Push position, on its own cache line.
+    alignas(64) std::atomic_size_t push_pos_ = {};
+
+    /// Pop position, on its own cache line.
+    alignas(64) std::atomic_size_t pop_pos_ = {};
+
+    /// Padding, so nothing else shares the cache line.
+    [[maybe_unused]] char padding_[64 - sizeof(std::atomic_size_t)] = {};
+};
+
+} // namespace pre
@@ -9,19 +9,41 @@ namespace pre {
 /// pushed onto the top/back and popped from the bottom/front.
 ///
 /// \note
-/// The implementation minimizes move operations by tracking
-/// the effective bottom and top of the queue. That is, popping
-/// shifts the bottom up instead of moving the elements
-/// down. When pushing shifts the top past the queue capacity, the
-/// implementation moves all elements down and resets the bottom
-/// to zero.
+/// The implementation is a circular buffer, so pushing and popping
+/// are constant time and never move other elements. If `MaxSize` is
+/// a power of 2, wrapping around is a mask, otherwise it is a compare and
+/// subtract. Because the elements may wrap around the end of the
+/// buffer, they are not contiguous in general. Batch consumers
+/// can use `spans()` to access them as (at most) two contiguous spans.
 ///
 template <typename Value, size_t MaxSize>
-struct StaticQueue : ArrayLike<StaticQueue<Value, MaxSize>, Value> {
+struct StaticQueue {
   public:
     // Sanity check.
     static_assert(MaxSize > 0);
 
+  public:
+    template <bool IsConst>
+    class Iterator;
+
+    typedef size_t size_type;
+
+    typedef std::ptrdiff_t difference_type;
+
+    typedef Value value_type;
+
+    typedef value_type& reference;
+
+    typedef const value_type& const_reference;
+
+    typedef Iterator<false> iterator;
+
+    typedef Iterator<true> const_iterator;
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
   public:
     constexpr StaticQueue() = default;
 
@@ -36,7 +58,7 @@ struct StaticQueue : ArrayLike<StaticQueue<Value, MaxSize>, Value> {
     /** \{ */
 
     constexpr size_t size() const noexcept {
-        return top_ - bot_;
+        return size_;
     }
 
     constexpr size_t max_size() const noexcept {
@@ -49,39 +71,134 @@ struct StaticQueue : ArrayLike<StaticQueue<Value, MaxSize>, Value> {
 
     constexpr void clear() noexcept {
         for (auto& value : *this)
-            value.~Value();
+            value = Value();
         bot_ = 0;
-        top_ = 0;
+        size_ = 0;
     }
 
     constexpr bool empty() const noexcept {
-        return bot_ == top_;
+        return size_ == 0;
     }
 
     constexpr bool full() const noexcept {
-        return bot_ == 0 && top_ == MaxSize;
+        return size_ == MaxSize;
     }
 
-    constexpr Value* begin() noexcept {
-        return &values_[0] + bot_;
+    constexpr iterator begin() noexcept {
+        return {this, 0};
     }
 
-    constexpr const Value* begin() const noexcept {
-        return &values_[0] + bot_;
+    constexpr const_iterator begin() const noexcept {
+        return {this, 0};
     }
 
-    constexpr Value* end() noexcept {
-        return &values_[0] + top_;
+    constexpr iterator end() noexcept {
+        return {this, size_};
     }
 
-    constexpr const Value* end() const noexcept {
-        return &values_[0] + top_;
+    constexpr const_iterator end() const noexcept {
+        return {this, size_};
     }
 
-    /** \} */
+    constexpr const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    constexpr const_iterator cend() const noexcept {
+        return end();
+    }
+
+    constexpr reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+
+    constexpr const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(end());
+    }
+
+    constexpr reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+
+    constexpr const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(begin());
+    }
+
+    constexpr const_reverse_iterator crbegin() const noexcept {
+        return rbegin();
+    }
+
+    constexpr const_reverse_iterator crend() const noexcept {
+        return rend();
+    }
+
+    constexpr reference front() noexcept {
+        return values_[bot_];
+    }
+
+    constexpr const_reference front() const noexcept {
+        return values_[bot_];
+    }
+
+    constexpr reference back() noexcept {
+        return values_[wrap_(bot_ + (size_ > 0 ? size_ : MaxSize) - 1)];
+    }
+
+    constexpr const_reference back() const noexcept {
+        return values_[wrap_(bot_ + (size_ > 0 ? size_ : MaxSize) - 1)];
+    }
+
+    /// Access element, counting negative positions from the back.
+    template <std::integral Int>
+    constexpr reference operator[](Int pos) noexcept {
+        return values_[index_(pos)];
+    }
+
+    /// Access element, counting negative positions from the back, const
+    /// variant.
+    template <std::integral Int>
+    constexpr const_reference operator[](Int pos) const noexcept {
+        return values_[index_(pos)];
+    }
+
+    /// Access element with bounds check, counting negative positions
+    /// from the back.
+    ///
+    /// \throw std::out_of_range  If out of range.
+    ///
+    template <std::integral Int>
+    constexpr reference at(Int pos) {
+        if constexpr (std::signed_integral<Int>) {
+            if (pos < 0)
+                pos += Int(size_);
+            if (pos < 0)
+                throw std::out_of_range(__func__);
+        }
+        if (size_t(pos) >= size_)
+            throw std::out_of_range(__func__);
+        return values_[index_(pos)];
+    }
+
+    /// Access element with bounds check, const variant.
+    ///
+    /// \throw std::out_of_range  If out of range.
+    ///
+    template <std::integral Int>
+    constexpr const_reference at(Int pos) const {
+        if constexpr (std::signed_integral<Int>) {
+            if (pos < 0)
+                pos += Int(size_);
+            if (pos < 0)
+                throw std::out_of_range(__func__);
+        }
+        if (size_t(pos) >= size_)
+            throw std::out_of_range(__func__);
+        return values_[index_(pos)];
+    }
 
-public:
+    /** \} */
 
+  public:
     /// \name Queue
     /** \{ */
 
@@ -130,13 +247,13 @@ public:
     /// \throw std::runtime_error  If empty.
     ///
     constexpr Value pop() {
-        if (bot_ == top_)
+        if (size_ == 0)
             throw std::runtime_error(__func__);
-        Value& value = values_[bot_++];
-        Value res = std::move(value);
-        value.~Value();
-        if (bot_ == top_) // Empty now?
-            bot_ = top_ = 0;
+        Value res = std::move(values_[bot_]);
+        bot_ = wrap_(bot_ + 1);
+        size_--;
+        if (size_ == 0)
+            bot_ = 0; // Keep the next batch contiguous.
         return res;
     }
 
@@ -145,36 +262,184 @@ public:
     /// \throw std::length_error  If full.
     ///
     constexpr void push(const Value& value) {
-        if (top_ >= MaxSize) {
-            if (bot_ == 0)
-                throw std::length_error(__func__);
-            Value* itr0 = &values_[0];
-            Value* itr1 = &values_[0] + bot_;
-            for (; itr1 < &values_[0] + top_; ++itr0, ++itr1) {
-                *itr0 = std::move(*itr1);
-                itr1->~Value();
-            }
-            top_ -= bot_;
-            bot_ = 0;
-        }
-        values_[top_++] = value;
+        if (size_ == MaxSize)
+            throw std::length_error(__func__);
+        values_[wrap_(bot_ + size_)] = value;
+        size_++;
+    }
+
+    /// Push top/back value, move variant.
+    ///
+    /// \throw std::length_error  If full.
+    ///
+    constexpr void push(Value&& value) {
+        if (size_ == MaxSize)
+            throw std::length_error(__func__);
+        values_[wrap_(bot_ + size_)] = std::move(value);
+        size_++;
+    }
+
+    /// Contiguous spans of all values, from bottom/front to top/back.
+    ///
+    /// The second span is non-empty only if the values wrap around the
+    /// end of the buffer.
+    ///
+    /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~{.cpp}
+    /// auto [span0, span1] = queue.spans();
+    /// process(span0);
+    /// process(span1);
+    /// queue.consume(span0.size() + span1.size());
+    /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    ///
+    constexpr std::pair<std::span<Value>, std::span<Value>> spans() noexcept {
+        size_t size0 = std::min(size_, MaxSize - bot_);
+        return {std::span<Value>(&values_[0] + bot_, size0),
+                std::span<Value>(&values_[0], size_ - size0)};
+    }
+
+    /// Contiguous spans of all values, const variant.
+    constexpr std::pair<std::span<const Value>, std::span<const Value>>
+    spans() const noexcept {
+        size_t size0 = std::min(size_, MaxSize - bot_);
+        return {std::span<const Value>(&values_[0] + bot_, size0),
+                std::span<const Value>(&values_[0], size_ - size0)};
+    }
+
+    /// Pop given number of bottom/front values without returning them,
+    /// e.g., after processing them in place through `spans()`.
+    ///
+    /// \throw std::runtime_error  If fewer values than given.
+    ///
+    constexpr void consume(size_t n) {
+        if (n > size_)
+            throw std::runtime_error(__func__);
+        bot_ = wrap_(bot_ + n);
+        size_ -= n;
+        if (size_ == 0)
+            bot_ = 0; // Keep the next batch contiguous.
     }
 
     /** \} */
 
   public:
     void serialize(auto& serializer) {
+        // Encode bottom and top buffer indexes, where the top index runs
+        // past the end of the buffer if the values wrap around. This
+        // reads archives from before the queue was circular.
+        size_t top = bot_ + size_;
         serializer <=> values_;
         serializer <=> bot_;
-        serializer <=> top_;
+        serializer <=> top;
+        size_ = top - bot_;
+    }
+
+  public:
+    /// A random-access iterator.
+    template <bool IsConst>
+    class Iterator {
+      public:
+        using Queue = std::conditional_t<IsConst, const StaticQueue, StaticQueue>;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, const Value*, Value*>;
+        using reference = std::conditional_t<IsConst, const Value&, Value&>;
+        constexpr Iterator() noexcept = default;
+        constexpr Iterator(Queue* queue, size_t pos) noexcept
+            : queue_(queue), pos_(pos) {
+        }
+        constexpr operator Iterator<true>() const noexcept
+            requires(!IsConst) {
+            return {queue_, pos_};
+        }
+        constexpr reference operator*() const noexcept {
+            return queue_->values_[queue_->wrap_(queue_->bot_ + pos_)];
+        }
+        constexpr pointer operator->() const noexcept {
+            return &operator*();
+        }
+        constexpr reference operator[](difference_type n) const noexcept {
+            return *(*this + n);
+        }
+        constexpr Iterator& operator++() noexcept {
+            ++pos_;
+            return *this;
+        }
+        constexpr Iterator& operator--() noexcept {
+            --pos_;
+            return *this;
+        }
+        constexpr Iterator operator++(int) noexcept {
+            Iterator copy = *this;
+            ++pos_;
+            return copy;
+        }
+        constexpr Iterator operator--(int) noexcept {
+            Iterator copy = *this;
+            --pos_;
+            return copy;
+        }
+        constexpr Iterator& operator+=(difference_type n) noexcept {
+            pos_ += n;
+            return *this;
+        }
+        constexpr Iterator& operator-=(difference_type n) noexcept {
+            pos_ -= n;
+            return *this;
+        }
+        constexpr Iterator operator+(difference_type n) const noexcept {
+            return {queue_, pos_ + n};
+        }
+        constexpr Iterator operator-(difference_type n) const noexcept {
+            return {queue_, pos_ - n};
+        }
+        friend constexpr Iterator operator+(
+                difference_type n, const Iterator& itr) noexcept {
+            return itr + n;
+        }
+        constexpr difference_type operator-(
+                const Iterator& other) const noexcept {
+            return difference_type(pos_) - difference_type(other.pos_);
+        }
+        constexpr auto operator<=>(const Iterator& other) const noexcept {
+            return pos_ <=> other.pos_;
+        }
+        constexpr bool operator==(const Iterator& other) const noexcept {
+            return pos_ == other.pos_;
+        }
+
+      private:
+        Queue* queue_ = nullptr;
+        size_t pos_ = 0;
+    };
+
+  private:
+    /// Wrap index in `[0, 2 * MaxSize)` to `[0, MaxSize)`.
+    static constexpr size_t wrap_(size_t index) noexcept {
+        if constexpr ((MaxSize & (MaxSize - 1)) == 0)
+            return index & (MaxSize - 1);
+        else
+            return index >= MaxSize ? index - MaxSize : index;
+    }
+
+    /// Buffer index of position, counting negative positions from the
+    /// back.
+    template <std::integral Int>
+    constexpr size_t index_(Int pos) const noexcept {
+        if constexpr (std::signed_integral<Int>)
+            if (pos < 0)
+                pos += Int(size_);
+        return wrap_(bot_ + size_t(pos));
     }
 
   private:
     Value values_[MaxSize] = {};
 
+    /// Buffer index of bottom/front value.
     size_t bot_ = 0;
 
-    size_t top_ = 0;
+    /// Size.
+    size_t size_ = 0;
 };
 
 } // namespace pre
@@ -0,0 +1,271 @@
+/*-*- C++ -*-*/
+#pragma once
+
+namespace pre {
+
+/// A static single-producer single-consumer queue.
+///
+/// A wait-free bounded queue (first-in first-out), for handing values
+/// from one producer thread to one consumer thread. Like `StaticQueue`,
+/// the values live in place in a fixed-capacity circular buffer. Only
+/// the producer may push, and only the consumer may pop.
+///
+/// \note
+/// The head (next to pop) and tail (next to push) positions are on
+/// separate cache lines, each next to a cached copy of the other
+/// position, so that in steady state the producer and consumer only
+/// touch each other's cache line when the queue looks full or empty.
+/// Positions run over `[0, 2 * MaxSize)` so that full and empty are
+/// distinguishable without giving up a slot, and wrapping is a mask if
+/// `MaxSize` is a power of 2, otherwise a compare and subtract.
+///
+template <typename Value, size_t MaxSize>
+struct StaticSpscQueue {
+  public:
+    // Sanity check.
+    static_assert(MaxSize > 0);
+
+  public:
+    StaticSpscQueue() = default;
+
+    StaticSpscQueue(const StaticSpscQueue&) = delete;
+
+  public:
+    /// \name Container API
+    /** \{ */
+
+    /// Size.
+    ///
+    /// \note
+    /// If the other thread is pushing or popping, this is only a
+    /// snapshot.
+    ///
+    size_t size() const noexcept {
+        return distance_(
+                head_.load(std::memory_order_acquire),
+                tail_.load(std::memory_order_acquire));
+    }
+
+    constexpr size_t max_size() const noexcept {
+        return MaxSize;
+    }
+
+    constexpr size_t capacity() const noexcept {
+        return MaxSize;
+    }
+
+    /// Empty? See `size()`.
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    /// Full? See `size()`.
+    bool full() const noexcept {
+        return size() == MaxSize;
+    }
+
+    /** \} */
+
+  public:
+    /// \name Producer
+    /** \{ */
+
+    /// Try to push top/back value.
+    ///
+    /// \returns
+    /// Returns true if successful, false if full.
+    ///
+    bool try_push(const Value& value) {
+        return push_n(std::span<const Value>(&value, 1)) == 1;
+    }
+
+    /// Try to push top/back value, move variant.
+    ///
+    /// \returns
+    /// Returns true if successful, false if full. If false, the
+    /// value is not moved from.
+    ///
+    bool try_push(Value&& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (free_count_(tail, 1) == 0)
+            return false;
+        values_[index_(tail)] = std::move(value);
+        tail_.store(advance_(tail, 1), std::memory_order_release);
+        return true;
+    }
+
+    /// Push top/back value.
+    ///
+    /// \throw std::length_error  If full.
+    ///
+    void push(const Value& value) {
+        if (!try_push(value))
+            throw std::length_error(__func__);
+    }
+
+    /// Push top/back value, move variant.
+    ///
+    /// \throw std::length_error  If full.
+    ///
+    void push(Value&& value) {
+        if (!try_push(std::move(value)))
+            throw std::length_error(__func__);
+    }
+
+    /// Push as many values as fit, in order.
+    ///
+    /// This copies at most two contiguous runs, and publishes them to
+    /// the consumer all at once.
+    ///
+    /// \returns
+    /// Number of values pushed.
+    ///
+    size_t push_n(std::span<const Value> values) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t count =
+                std::min(values.size(), free_count_(tail, values.size()));
+        if (count == 0)
+            return 0;
+        size_t index = index_(tail);
+        size_t count0 = std::min(count, MaxSize - index);
+        std::copy_n(values.data(), count0, &values_[0] + index);
+        std::copy_n(values.data() + count0, count - count0, &values_[0]);
+        tail_.store(advance_(tail, count), std::memory_order_release);
+        return count;
+    }
+
+    /** \} */
+
+  public:
+    /// \name Consumer
+    /** \{ */
+
+    /// Try to pop bottom/front value.
+    ///
+    /// \param[out] value
+    /// Value, only assigned if successful.
+    ///
+    /// \returns
+    /// Returns true if successful, false if empty.
+    ///
+    bool try_pop(Value& value) {
+        return pop_n(std::span<Value>(&value, 1)) == 1;
+    }
+
+    /// Try to pop bottom/front value.
+    ///
+    /// \returns
+    /// Returns value if successful, `std::nullopt` if empty.
+    ///
+    std::optional<Value> try_pop() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (used_count_(head, 1) == 0)
+            return std::nullopt;
+        std::optional<Value> res(std::move(values_[index_(head)]));
+        head_.store(advance_(head, 1), std::memory_order_release);
+        return res;
+    }
+
+    /// Pop and return bottom/front value.
+    ///
+    /// \throw std::runtime_error  If empty.
+    ///
+    Value pop() {
+        std::optional<Value> res = try_pop();
+        if (!res)
+            throw std::runtime_error(__func__);
+        return std::move(*res);
+    }
+
+    /// Pop as many values as available, up to the given span size.
+    ///
+    /// This moves at most two contiguous runs, and releases their slots
+    /// to the producer all at once.
+    ///
+    /// \returns
+    /// Number of values popped.
+    ///
+    size_t pop_n(std::span<Value> values) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t count =
+                std::min(values.size(), used_count_(head, values.size()));
+        if (count == 0)
+            return 0;
+        size_t index = index_(head);
+        size_t count0 = std::min(count, MaxSize - index);
+        std::move(
+                &values_[0] + index, &values_[0] + index + count0,
+                values.data());
+        std::move(
+                &values_[0], &values_[0] + (count - count0),
+                values.data() + count0);
+        head_.store(advance_(head, count), std::memory_order_release);
+        return count;
+    }
+
+    /** \} */
+
+  private:
+    /// Wrap position in `[0, 2 * Size)` to `[0, Size)`.
+    template <size_t Size>
+    static constexpr size_t wrap_(size_t pos) noexcept {
+        if constexpr ((Size & (Size - 1)) == 0)
+            return pos & (Size - 1);
+        else
+            return pos >= Size ? pos - Size : pos;
+    }
+
+    /// Buffer index of position.
+    static constexpr size_t index_(size_t pos) noexcept {
+        return wrap_<MaxSize>(pos);
+    }
+
+    /// Advance position.
+    static constexpr size_t advance_(size_t pos, size_t count) noexcept {
+        return wrap_<2 * MaxSize>(pos + count);
+    }
+
+    /// Number of values from head to tail position.
+    static constexpr size_t distance_(size_t head, size_t tail) noexcept {
+        return wrap_<2 * MaxSize>(tail + 2 * MaxSize - head);
+    }
+
+    /// Number of free slots, for the producer, refreshing the cached head
+    /// position only if fewer than wanted.
+    size_t free_count_(size_t tail, size_t wanted) noexcept {
+        size_t count = MaxSize - distance_(head_cache_, tail);
+        if (count < wanted) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            count = MaxSize - distance_(head_cache_, tail);
+        }
+        return count;
+    }
+
+    /// Number of used slots, for the consumer, refreshing the cached tail
+    /// position only if fewer than wanted.
+    size_t used_count_(size_t head, size_t wanted) noexcept {
+        size_t count = distance_(head, tail_cache_);
+        if (count < wanted) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            count = distance_(head, tail_cache_);
+        }
+        return count;
+    }
+
+  private:
+    /// Head position, written by the consumer.
+    alignas(64) std::atomic_size_t head_ = {};
+
+    /// Cached tail position, for the consumer.
+    size_t tail_cache_ = 0;
+
+    /// Tail position, written by the producer.
+    alignas(64) std::atomic_size_t tail_ = {};
+
+    /// Cached head position, for the producer.
+    size_t head_cache_ = 0;
+
+    alignas(64) Value values_[MaxSize] = {};
+};
+
+} // namespace pre